@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+# Profile-guided optimization build of BadgerDB:
+#   1. build instrumented binaries (BADGERDB_PGO=GENERATE),
+#   2. run the benchmark suite and YCSB driver to collect profiles,
+#   3. rebuild using those profiles (BADGERDB_PGO=USE).
+#
+# Both phases use the same build directory: GCC names profile files after the
+# object file paths, so the objects must not move between them.
+#
+# Usage: scripts/pgo_build.sh [build-dir] [extra cmake args...]
+# The optimized binaries end up in <build-dir> (default: build-pgo).
+
+set -e
+
+BUILD_DIR=${1:-build-pgo}
+[ $# -gt 0 ] && shift
+mkdir -p "$BUILD_DIR"
+PROFILE_DIR=$(cd "$BUILD_DIR" && pwd)/pgo-profiles
+
+rm -rf "$PROFILE_DIR"
+cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release \
+  -DBADGERDB_PGO=GENERATE -DBADGERDB_PGO_DIR="$PROFILE_DIR" "$@"
+cmake --build "$BUILD_DIR" -j --clean-first
+cmake --build "$BUILD_DIR" --target pgo-train
+
+if ls "$PROFILE_DIR"/*.profraw >/dev/null 2>&1; then
+  # clang: raw profiles need merging before they can be used
+  llvm-profdata merge -o "$PROFILE_DIR/badgerdb.profdata" \
+    "$PROFILE_DIR"/*.profraw
+fi
+
+cmake -S . -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release \
+  -DBADGERDB_PGO=USE -DBADGERDB_PGO_DIR="$PROFILE_DIR" "$@"
+cmake --build "$BUILD_DIR" -j --clean-first
@@ -0,0 +1,407 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bench/benchmark.h"
+#include "bench/bench_util.h"
+#include "buffer.h"
+#include "bufHashTbl.h"
+#include "vm_buffer.h"
+#include "exceptions/hash_not_found_exception.h"
+
+namespace badgerdb {
+namespace bench {
+
+namespace {
+
+/**
+ * Hash table sized the way BufMgr sizes it for <bufs> frames.
+ */
+int hashTableSize(const std::int64_t bufs) {
+  return ((((int)(bufs * 1.2)) * 2) / 2) + 1;
+}
+
+}
+
+/**
+ * Lookup of resident pages in a table holding range(0) entries.
+ */
+static void BM_HashTblLookup(State& state) {
+  const std::int64_t n = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("hash", 0);
+  MemoryBudget budget;
+  BufHashTbl table(hashTableSize(n), n + 1, &budget);
+  for (std::int64_t i = 0; i < n; ++i) {
+    table.insert(scratch.file(), i + 1, i);
+  }
+  std::mt19937 rng(42);
+  std::vector<PageId> keys(4096);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = rng() % n + 1;
+  }
+  FrameId frame = 0;
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    table.lookup(scratch.file(), keys[k++ & 4095], frame);
+    DoNotOptimize(frame);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HashTblLookup)->Range(1024, 1 << 20, 32);
+
+/**
+ * Lookups of range(0) pages at a time with lookupMany, in a table holding
+ * range(1) entries.  The keys are spread over the whole table, so at the
+ * larger sizes (above the last-level cache) nearly every chain head and
+ * bucket is a cache miss; a batch of one takes those misses one after
+ * another, as lookup() does.
+ */
+static void BM_HashTblLookupMany(State& state) {
+  const std::size_t batch = state.range(0);
+  const std::int64_t n = state.range(1);
+  ScratchFile& scratch = ScratchFile::shared("hash", 0);
+  MemoryBudget budget;
+  BufHashTbl table(hashTableSize(n), n + 1, &budget);
+  for (std::int64_t i = 0; i < n; ++i) {
+    table.insert(scratch.file(), i + 1, i);
+  }
+  std::mt19937 rng(42);
+  std::vector<PageKey> keys(1 << 20);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = makePageKey(scratch.file()->id(), rng() % n + 1);
+  }
+  std::vector<FrameId> frames(batch);
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    DoNotOptimize(table.lookupMany(&keys[k], batch, &frames[0]));
+    k += batch;
+    if (k + batch > keys.size()) {
+      k = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_HashTblLookupMany)
+    ->Args({1, 1024})->Args({16, 1024})->Args({64, 1024})
+    ->Args({1, 1 << 23})->Args({16, 1 << 23})->Args({64, 1 << 23});
+
+/**
+ * Lookup of absent pages: the miss path walks the whole chain and throws.
+ */
+static void BM_HashTblLookupMiss(State& state) {
+  const std::int64_t n = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("hash", 0);
+  MemoryBudget budget;
+  BufHashTbl table(hashTableSize(n), n + 1, &budget);
+  for (std::int64_t i = 0; i < n; ++i) {
+    table.insert(scratch.file(), i + 1, i);
+  }
+  FrameId frame = 0;
+  PageId page_no = n + 1;
+  while (state.KeepRunning()) {
+    try {
+      table.lookup(scratch.file(), page_no++, frame);
+    } catch (const HashNotFoundException&) {
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HashTblLookupMiss)->Arg(1024)->Arg(1 << 20);
+
+/**
+ * Insert followed by remove of one entry in a table holding range(0) entries.
+ */
+static void BM_HashTblInsertRemove(State& state) {
+  const std::int64_t n = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("hash", 0);
+  MemoryBudget budget;
+  BufHashTbl table(hashTableSize(n), n + 1, &budget);
+  for (std::int64_t i = 0; i < n; ++i) {
+    table.insert(scratch.file(), i + 1, i);
+  }
+  PageId page_no = n + 1;
+  while (state.KeepRunning()) {
+    table.insert(scratch.file(), page_no, 0);
+    table.remove(scratch.file(), page_no);
+    ++page_no;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HashTblInsertRemove)->Range(1024, 1 << 20, 32);
+
+/**
+ * readPage + unPinPage of pages that are all resident in a pool of range(0)
+ * frames.
+ */
+static void BM_ReadPageHit(State& state) {
+  const std::int64_t bufs = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("hit", bufs);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  BufMgr mgr(bufs);
+  Page* page;
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    mgr.readPage(file, pages[i], page);
+    mgr.unPinPage(file, pages[i], false);
+  }
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = pages[k];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+    if (++k == pages.size()) {
+      k = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ReadPageHit)->Arg(64)->Arg(1024);
+
+/**
+ * readPage + unPinPage cycling through twice as many pages as the pool has
+ * frames, so every read misses and evicts a clean page.
+ */
+static void BM_ReadPageMiss(State& state) {
+  const std::int64_t bufs = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("miss", bufs * 2);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  BufMgr mgr(bufs);
+  Page* page;
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = pages[k];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+    if (++k == pages.size()) {
+      k = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * Page::SIZE);
+}
+BENCHMARK(BM_ReadPageMiss)->Arg(64)->Arg(512);
+
+/**
+ * Cost of victim selection when range(0) percent of a 512-frame pool is
+ * pinned.  Each iteration is a readPage miss, so allocBuf has to sweep past
+ * the pinned frames; the rest of the miss path is the same across arguments.
+ */
+static void BM_AllocBufPinned(State& state) {
+  const std::int64_t bufs = 512;
+  const std::int64_t pinned = bufs * state.range(0) / 100;
+  ScratchFile& pinned_scratch = ScratchFile::shared("pinned", bufs);
+  ScratchFile& scratch = ScratchFile::shared("miss", bufs * 2);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  BufMgr mgr(bufs);
+  Page* page;
+  for (std::int64_t i = 0; i < pinned; ++i) {
+    mgr.readPage(pinned_scratch.file(), pinned_scratch.pageNumbers()[i], page);
+  }
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = pages[k];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+    if (++k == pages.size()) {
+      k = 0;
+    }
+  }
+  for (std::int64_t i = 0; i < pinned; ++i) {
+    mgr.unPinPage(pinned_scratch.file(), pinned_scratch.pageNumbers()[i],
+                  false);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AllocBufPinned)->Arg(0)->Arg(50)->Arg(90)->Arg(99);
+
+/**
+ * A scan through twice as many pages as a 4096-frame pool holds, every read
+ * a miss, with range(0) victims collected per sweep of the clock.  With 1
+ * each miss runs the clock from where the last one stopped.
+ */
+static void BM_ScanEvictBatch(State& state) {
+  const std::int64_t bufs = 4096;
+  ScratchFile& scratch = ScratchFile::shared("scan", bufs * 2);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  BufMgr mgr(bufs);
+  mgr.setEvictionBatch(state.range(0));
+  Page* page;
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = pages[k];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+    if (++k == pages.size()) {
+      k = 0;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ScanEvictBatch)->Arg(1)->Arg(16)->Arg(64);
+
+/**
+ * flushFile of a file with four pages in a pool of range(0) frames that is
+ * otherwise full of another file's pages.  The cost should not depend on
+ * the pool size.
+ */
+static void BM_FlushSmallFile(State& state) {
+  const std::int64_t bufs = state.range(0);
+  ScratchFile& big = ScratchFile::shared("big", bufs);
+  ScratchFile& small = ScratchFile::shared("small", 4);
+  BufMgr mgr(bufs);
+  Page* page;
+  for (std::int64_t i = 0; i < bufs - 4; ++i) {
+    mgr.readPage(big.file(), big.pageNumbers()[i], page);
+    mgr.unPinPage(big.file(), big.pageNumbers()[i], false);
+  }
+  while (state.KeepRunning()) {
+    for (std::size_t i = 0; i < small.pageNumbers().size(); ++i) {
+      mgr.readPage(small.file(), small.pageNumbers()[i], page);
+      mgr.unPinPage(small.file(), small.pageNumbers()[i], false);
+    }
+    mgr.flushFile(small.file());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FlushSmallFile)->Arg(1024)->Arg(8192);
+
+/**
+ * Pins and unpins resident pages at random positions in a pool of range(0)
+ * frames, one readPage() at a time.  Baseline for BM_ScatteredHitBatch.
+ */
+static void BM_ScatteredHit(State& state) {
+  const std::int64_t bufs = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("scattered", bufs);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  BufMgr mgr(bufs);
+  Page* page;
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    mgr.readPage(file, pages[i], page);
+    mgr.unPinPage(file, pages[i], false);
+  }
+  std::mt19937 rng(42);
+  std::vector<PageId> keys(1 << 16);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = pages[rng() % pages.size()];
+  }
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = keys[k++ & (keys.size() - 1)];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ScatteredHit)->Arg(1024)->Arg(1 << 16);
+
+/**
+ * BM_ScatteredHit against a VmBufMgr, which translates page numbers with an
+ * array access instead of a hash table lookup.
+ */
+static void BM_VmScatteredHit(State& state) {
+  const std::int64_t bufs = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("scattered", bufs);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  VmBufMgr mgr(bufs);
+  Page* page;
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    mgr.readPage(file, pages[i], page);
+    mgr.unPinPage(file, pages[i], false);
+  }
+  std::mt19937 rng(42);
+  std::vector<PageId> keys(1 << 16);
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = pages[rng() % pages.size()];
+  }
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = keys[k++ & (keys.size() - 1)];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+  }
+  mgr.flushFile(file);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VmScatteredHit)->Arg(1024)->Arg(1 << 16);
+
+/**
+ * readPage + unPinPage cycling through twice as many pages as a VmBufMgr of
+ * range(0) frames holds, so every read misses, evicts a clean page and
+ * returns its memory with madvise.  Compare with BM_ReadPageMiss.
+ */
+static void BM_VmReadMiss(State& state) {
+  const std::int64_t bufs = state.range(0);
+  ScratchFile& scratch = ScratchFile::shared("miss", bufs * 2);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  VmBufMgr mgr(bufs);
+  Page* page;
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const PageId page_no = pages[k];
+    mgr.readPage(file, page_no, page);
+    mgr.unPinPage(file, page_no, false);
+    if (++k == pages.size()) {
+      k = 0;
+    }
+  }
+  mgr.flushFile(file);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VmReadMiss)->Arg(64)->Arg(512);
+
+/**
+ * Like BM_ScatteredHit, but pinning range(0) pages at a time with
+ * readPages(), as a fetch of a list of record ids does.  The larger pool
+ * (512 MiB of frames) is bigger than the last-level cache, so descriptors
+ * and hash chains are cache misses.
+ */
+static void BM_ScatteredHitBatch(State& state) {
+  const std::size_t batch = state.range(0);
+  const std::int64_t bufs = state.range(1);
+  ScratchFile& scratch = ScratchFile::shared("scattered", bufs);
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  BufMgr mgr(bufs);
+  Page* page;
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    mgr.readPage(file, pages[i], page);
+    mgr.unPinPage(file, pages[i], false);
+  }
+  std::mt19937 rng(42);
+  std::vector<std::vector<PageId> > batches(1024);
+  for (std::size_t i = 0; i < batches.size(); ++i) {
+    for (std::size_t j = 0; j < batch; ++j) {
+      batches[i].push_back(pages[rng() % pages.size()]);
+    }
+  }
+  std::vector<Page*> pinned(batch);
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    const std::vector<PageId>& page_nos = batches[k++ & 1023];
+    mgr.readPages(file, page_nos, &pinned[0]);
+    for (std::size_t j = 0; j < batch; ++j) {
+      mgr.unPinPage(file, page_nos[j], false);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_ScatteredHitBatch)
+    ->Args({16, 1024})->Args({64, 1024})
+    ->Args({16, 1 << 16})->Args({64, 1 << 16});
+
+}
+}
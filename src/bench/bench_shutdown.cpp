@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench/benchmark.h"
+#include "bench/bench_util.h"
+#include "buffer.h"
+
+namespace badgerdb {
+namespace bench {
+
+/**
+ * Name of the i-th of the files BM_ShutdownDirty spreads its pages over.
+ */
+static std::string shutdownFileName(const std::int64_t f) {
+  std::stringstream name;
+  name << "shutdown" << f;
+  return name.str();
+}
+
+/**
+ * Time for ~BufMgr to write back a pool of range(0) frames, all dirty, whose
+ * pages are spread evenly over range(1) files, using range(2) I/O threads.
+ * Filling the pool is not timed.  Items are frames written.  The files are
+ * kept across the runs of an instance and removed after its last one.
+ *
+ * The 1M-frame instances need about 8 GiB of memory for the pool and the
+ * same on disk for the files, so they are only registered when the
+ * environment variable BADGERDB_BENCH_HUGE is set; run them with
+ *   BADGERDB_BENCH_HUGE=1 badgerdb_bench --benchmark_filter=ShutdownDirty/1048576
+ * Even then they report an error on machines without room for the pool.
+ */
+static void BM_ShutdownDirty(State& state) {
+  const std::int64_t frames = state.range(0);
+  const std::int64_t num_files = state.range(1);
+  const std::int64_t memory =
+      static_cast<std::int64_t>(sysconf(_SC_PHYS_PAGES)) *
+      sysconf(_SC_PAGE_SIZE);
+  if (frames * static_cast<std::int64_t>(Page::SIZE) > memory / 4 * 3) {
+    state.SkipWithError("buffer pool does not fit in memory");
+    return;
+  }
+
+  std::vector<ScratchFile*> files;
+  for (std::int64_t f = 0; f < num_files; ++f) {
+    files.push_back(
+        &ScratchFile::shared(shutdownFileName(f), frames / num_files));
+  }
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    std::unique_ptr<BufMgr> mgr(new BufMgr(frames));
+    mgr->setFlushThreads(state.range(2));
+    Page* page;
+    for (std::size_t f = 0; f < files.size(); ++f) {
+      File* file = files[f]->file();
+      const std::vector<PageId>& pages = files[f]->pageNumbers();
+      for (std::size_t i = 0; i < pages.size(); ++i) {
+        mgr->readPage(file, pages[i], page);
+        mgr->unPinPage(file, pages[i], true);
+      }
+    }
+    state.ResumeTiming();
+    mgr.reset();
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+  state.SetBytesProcessed(state.iterations() * frames * Page::SIZE);
+}
+
+static void BM_ShutdownDirtyTeardown(const State& state) {
+  for (std::int64_t f = 0; f < state.range(1); ++f) {
+    ScratchFile::dropShared(shutdownFileName(f), state.range(0) / state.range(1));
+  }
+}
+
+BENCHMARK(BM_ShutdownDirty)
+    ->Args({1 << 14, 1, 1})
+    ->Args({1 << 14, 16, 1})
+    ->Args({1 << 14, 16, 4})
+    ->Args({1 << 17, 16, 1})
+    ->Args({1 << 17, 16, 8})
+    ->Teardown(BM_ShutdownDirtyTeardown);
+
+static Benchmark* const huge_shutdown_registration __attribute__((unused)) =
+    std::getenv("BADGERDB_BENCH_HUGE") == NULL ? NULL :
+    RegisterBenchmark("BM_ShutdownDirty", BM_ShutdownDirty)
+        ->Args({1 << 20, 16, 1})
+        ->Args({1 << 20, 16, 8})
+        ->Teardown(BM_ShutdownDirtyTeardown);
+
+}
+}
@@ -0,0 +1,188 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench/benchmark.h"
+#include "bench/bench_util.h"
+#include "file.h"
+#include "file_iterator.h"
+#include "page.h"
+
+namespace badgerdb {
+namespace bench {
+
+/**
+ * Page::insertRecord of range(0)-byte records; the page is reset when full.
+ */
+static void BM_PageInsertRecord(State& state) {
+  const std::string record(state.range(0), 'x');
+  Page page;
+  while (state.KeepRunning()) {
+    if (!page.hasSpaceForRecord(record)) {
+      page = Page();
+    }
+    DoNotOptimize(page.insertRecord(record));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PageInsertRecord)->Arg(16)->Arg(128)->Arg(1024);
+
+/**
+ * Page::getRecord of random records on a full page of range(0)-byte records.
+ */
+static void BM_PageGetRecord(State& state) {
+  const std::string record(state.range(0), 'x');
+  Page page;
+  std::vector<RecordId> rids;
+  while (page.hasSpaceForRecord(record)) {
+    rids.push_back(page.insertRecord(record));
+  }
+  std::mt19937 rng(42);
+  std::vector<RecordId> order(4096);
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    order[i] = rids[rng() % rids.size()];
+  }
+  std::size_t k = 0;
+  while (state.KeepRunning()) {
+    DoNotOptimize(page.getRecord(order[k++ & 4095]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PageGetRecord)->Arg(16)->Arg(128)->Arg(1024);
+
+/**
+ * Page::deleteRecord of a random record on a full page of range(0)-byte
+ * records, followed by the insert that refills its slot.  Deletes compact the
+ * data area, so this is dominated by the record shuffle.
+ */
+static void BM_PageDeleteInsertRecord(State& state) {
+  const std::string record(state.range(0), 'x');
+  Page page;
+  std::vector<RecordId> rids;
+  while (page.hasSpaceForRecord(record)) {
+    rids.push_back(page.insertRecord(record));
+  }
+  std::mt19937 rng(42);
+  while (state.KeepRunning()) {
+    const std::size_t victim = rng() % rids.size();
+    page.deleteRecord(rids[victim]);
+    rids[victim] = page.insertRecord(record);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PageDeleteInsertRecord)->Arg(16)->Arg(128)->Arg(1024);
+
+/**
+ * File::readPage of random pages in a file of range(0) pages.
+ */
+static void BM_FileReadPage(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("file", state.range(0));
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  std::mt19937 rng(42);
+  while (state.KeepRunning()) {
+    DoNotOptimize(file->readPage(pages[rng() % pages.size()]));
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * Page::SIZE);
+}
+BENCHMARK(BM_FileReadPage)->Arg(1024);
+
+/**
+ * File::readPages of range(1) adjacent pages at a random position in a file
+ * of range(0) pages: one preadv per batch.  Items are pages.
+ */
+static void BM_FileReadPages(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("file", state.range(0));
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  const std::size_t count = state.range(1);
+  std::vector<Page> images(count);
+  std::vector<Page*> frames(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    frames[i] = &images[i];
+  }
+  std::mt19937 rng(42);
+  while (state.KeepRunning()) {
+    file->readPages(pages[rng() % (pages.size() - count + 1)], count,
+                    &frames[0]);
+    DoNotOptimize(images[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.SetBytesProcessed(state.iterations() * count * Page::SIZE);
+}
+BENCHMARK(BM_FileReadPages)->Args({1024, 1})->Args({1024, 16})
+    ->Args({1024, 64});
+
+/**
+ * File::writePage of random pages in a file of range(0) pages.
+ */
+static void BM_FileWritePage(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("file", state.range(0));
+  File* file = scratch.file();
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  std::vector<Page> images;
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    images.push_back(file->readPage(pages[i]));
+  }
+  std::mt19937 rng(42);
+  while (state.KeepRunning()) {
+    file->writePage(images[rng() % images.size()]);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * Page::SIZE);
+}
+BENCHMARK(BM_FileWritePage)->Arg(1024);
+
+/**
+ * Full FileIterator scan over a file of range(0) pages, dereferencing each
+ * page.  Items are pages.
+ */
+static void BM_FileIteratorScan(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("file", state.range(0));
+  File* file = scratch.file();
+  std::int64_t pages = 0;
+  while (state.KeepRunning()) {
+    for (FileIterator iter = file->begin(); iter != file->end(); ++iter) {
+      DoNotOptimize(*iter);
+      ++pages;
+    }
+  }
+  state.SetItemsProcessed(pages);
+  state.SetBytesProcessed(pages * Page::SIZE);
+}
+BENCHMARK(BM_FileIteratorScan)->Arg(1024);
+
+/**
+ * File::exists and File::isOpen on a file that is open.
+ */
+static void BM_FileExists(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("file", 1);
+  const std::string name = scratch.file()->filename();
+  while (state.KeepRunning()) {
+    DoNotOptimize(File::exists(name));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FileExists);
+
+static void BM_FileIsOpen(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("file", 1);
+  const std::string name = scratch.file()->filename();
+  while (state.KeepRunning()) {
+    DoNotOptimize(File::isOpen(name));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FileIsOpen);
+
+}
+}
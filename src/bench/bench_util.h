@@ -0,0 +1,111 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+namespace bench {
+
+/**
+ * @brief A database file that exists for the lifetime of the object.
+ *
+ * Any stale file with the same name is removed on construction, and the file
+ * is removed again on destruction.
+ */
+class ScratchFile {
+ public:
+  /**
+   * Creates the file and allocates <num_pages> pages in it, each holding one
+   * small record.
+   *
+   * @param name       Name of the file.
+   * @param num_pages  Number of pages to allocate.
+   */
+  ScratchFile(const std::string& name, const PageId num_pages)
+      : name_(name) {
+    removeIfExists(name_);
+    file_.reset(new File(File::create(name_)));
+    for (PageId i = 0; i < num_pages; ++i) {
+      Page page = file_->allocatePage();
+      std::stringstream ss;
+      ss << name_ << " page " << page.page_number();
+      page.insertRecord(ss.str());
+      file_->writePage(page);
+      page_numbers_.push_back(page.page_number());
+    }
+  }
+
+  ~ScratchFile() {
+    file_.reset();
+    removeIfExists(name_);
+  }
+
+  File* file() { return file_.get(); }
+
+  /**
+   * Numbers of the pages allocated by the constructor, in allocation order.
+   */
+  const std::vector<PageId>& pageNumbers() const { return page_numbers_; }
+
+  /**
+   * Returns a file with the given name and page count, creating it on first
+   * use.  Files are kept until the process exits so that repeated runs of a
+   * benchmark (with growing iteration counts) do not pay the setup again.
+   */
+  static ScratchFile& shared(const std::string& name, const PageId num_pages) {
+    std::unique_ptr<ScratchFile>& slot = sharedFiles()[sharedName(name, num_pages)];
+    if (!slot) {
+      slot.reset(new ScratchFile(sharedName(name, num_pages), num_pages));
+    }
+    return *slot;
+  }
+
+  /**
+   * Removes a file returned by shared(), for benchmarks whose files are too
+   * large to keep until the process exits.
+   */
+  static void dropShared(const std::string& name, const PageId num_pages) {
+    sharedFiles().erase(sharedName(name, num_pages));
+  }
+
+  static void removeIfExists(const std::string& name) {
+    try {
+      File::remove(name);
+    } catch (const FileNotFoundException&) {
+    }
+  }
+
+ private:
+  static std::map<std::string, std::unique_ptr<ScratchFile> >& sharedFiles() {
+    static std::map<std::string, std::unique_ptr<ScratchFile> > files;
+    return files;
+  }
+
+  static std::string sharedName(const std::string& name,
+                                const PageId num_pages) {
+    std::stringstream key;
+    key << "bench." << name << "." << num_pages;
+    return key.str();
+  }
+
+  std::string name_;
+  std::unique_ptr<File> file_;
+  std::vector<PageId> page_numbers_;
+};
+
+}
+}
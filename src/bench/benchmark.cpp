@@ -0,0 +1,368 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bench/benchmark.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace badgerdb {
+namespace bench {
+
+namespace {
+
+std::vector<std::unique_ptr<Benchmark> >& registry() {
+  static std::vector<std::unique_ptr<Benchmark> > benchmarks;
+  return benchmarks;
+}
+
+std::string jsonEscape(const std::string& s) {
+  std::string out;
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    const char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+}
+
+State::State(const std::int64_t max_iterations,
+             const std::vector<std::int64_t>& args)
+    : max_iterations_(max_iterations),
+      remaining_(max_iterations),
+      args_(args),
+      started_(false),
+      running_(false),
+      cpu_start_(0),
+      real_seconds_(0),
+      cpu_seconds_(0),
+      items_processed_(0),
+      bytes_processed_(0) {
+}
+
+void State::PauseTiming() {
+  if (!running_) {
+    return;
+  }
+  real_seconds_ += std::chrono::duration<double>(Clock::now() -
+                                                 real_start_).count();
+  cpu_seconds_ += static_cast<double>(std::clock() - cpu_start_) /
+                  CLOCKS_PER_SEC;
+  running_ = false;
+}
+
+void State::ResumeTiming() {
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  cpu_start_ = std::clock();
+  real_start_ = Clock::now();
+}
+
+Benchmark* RegisterBenchmark(const char* name, Function fn) {
+  registry().push_back(std::unique_ptr<Benchmark>(new Benchmark(name, fn)));
+  return registry().back().get();
+}
+
+/**
+ * @brief Result of running one benchmark instance.
+ */
+struct Result {
+  std::string name;
+  std::int64_t iterations;
+  double real_ns;
+  double cpu_ns;
+  double items_per_second;
+  double bytes_per_second;
+  std::string label;
+  std::string error;
+};
+
+/**
+ * @brief Runs benchmark instances, growing the iteration count until the
+ *        measured time reaches the requested minimum.
+ */
+class Runner {
+ public:
+  explicit Runner(const double min_time) : min_time_(min_time) {}
+
+  Result run(const Benchmark& bm, const std::vector<std::int64_t>& args,
+             const std::string& name) const {
+    std::int64_t iters = 1;
+    while (true) {
+      State state(iters, args);
+      bm.fn_(state);
+      const bool done = !state.error_.empty() ||
+                        state.real_seconds_ >= min_time_ ||
+                        iters >= kMaxIterations;
+      if (done) {
+        Result r;
+        r.name = name;
+        r.iterations = iters;
+        r.real_ns = state.real_seconds_ * 1e9 / iters;
+        r.cpu_ns = state.cpu_seconds_ * 1e9 / iters;
+        r.items_per_second = state.real_seconds_ > 0 ?
+            state.items_processed_ / state.real_seconds_ : 0;
+        r.bytes_per_second = state.real_seconds_ > 0 ?
+            state.bytes_processed_ / state.real_seconds_ : 0;
+        r.label = state.label_;
+        r.error = state.error_;
+        if (bm.teardown_ != NULL) {
+          bm.teardown_(state);
+        }
+        return r;
+      }
+      // Aim 40% past the minimum, but never grow more than 10x per round.
+      double multiplier = state.real_seconds_ > 0 ?
+          min_time_ * 1.4 / state.real_seconds_ : 10.0;
+      multiplier = std::min(10.0, std::max(multiplier, 2.0));
+      iters = std::min<std::int64_t>(kMaxIterations,
+                                     static_cast<std::int64_t>(
+                                         iters * multiplier + 0.5));
+    }
+  }
+
+  static std::string instanceName(const Benchmark& bm,
+                                  const std::vector<std::int64_t>& args) {
+    std::stringstream ss;
+    ss << bm.name_;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+      ss << "/" << args[i];
+    }
+    return ss.str();
+  }
+
+  static void instances(
+      std::vector<std::pair<const Benchmark*, std::vector<std::int64_t> > >&
+          out) {
+    for (std::size_t i = 0; i < registry().size(); ++i) {
+      const Benchmark& bm = *registry()[i];
+      if (bm.args_.empty()) {
+        out.push_back(std::make_pair(&bm, std::vector<std::int64_t>()));
+      }
+      for (std::size_t j = 0; j < bm.args_.size(); ++j) {
+        out.push_back(std::make_pair(&bm, bm.args_[j]));
+      }
+    }
+  }
+
+ private:
+  static const std::int64_t kMaxIterations = 1000000000;
+
+  double min_time_;
+};
+
+const std::int64_t Runner::kMaxIterations;
+
+namespace {
+
+void printConsole(std::ostream& os, const Result& r) {
+  char line[256];
+  if (!r.error.empty()) {
+    std::snprintf(line, sizeof(line), "%-48s ERROR: %s\n", r.name.c_str(),
+                  r.error.c_str());
+    os << line;
+    return;
+  }
+  std::snprintf(line, sizeof(line), "%-48s %12.1f ns %12.1f ns %12lld",
+                r.name.c_str(), r.real_ns, r.cpu_ns,
+                static_cast<long long>(r.iterations));
+  os << line;
+  if (r.items_per_second > 0) {
+    std::snprintf(line, sizeof(line), " %10.3fM items/s",
+                  r.items_per_second / 1e6);
+    os << line;
+  }
+  if (r.bytes_per_second > 0) {
+    std::snprintf(line, sizeof(line), " %10.3f MiB/s",
+                  r.bytes_per_second / (1024.0 * 1024.0));
+    os << line;
+  }
+  if (!r.label.empty()) {
+    os << " " << r.label;
+  }
+  os << "\n";
+}
+
+void printJson(std::ostream& os, const std::vector<Result>& results,
+               const std::vector<std::pair<std::string, std::string> >&
+                   context) {
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host) - 1);
+  char date[64] = "";
+  const std::time_t now = std::time(NULL);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z",
+                std::localtime(&now));
+
+  os << "{\n  \"context\": {\n";
+  os << "    \"date\": \"" << date << "\",\n";
+  os << "    \"host_name\": \"" << jsonEscape(host) << "\",\n";
+  os << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+  os << "    \"library_build_type\": \"release\"";
+#else
+  os << "    \"library_build_type\": \"debug\"";
+#endif
+  for (std::size_t i = 0; i < context.size(); ++i) {
+    os << ",\n    \"" << jsonEscape(context[i].first) << "\": \""
+       << jsonEscape(context[i].second) << "\"";
+  }
+  os << "\n  },\n  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    os << (i == 0 ? "\n" : ",\n") << "    {\n";
+    os << "      \"name\": \"" << jsonEscape(r.name) << "\",\n";
+    if (!r.error.empty()) {
+      os << "      \"error_occurred\": true,\n";
+      os << "      \"error_message\": \"" << jsonEscape(r.error) << "\"\n";
+      os << "    }";
+      continue;
+    }
+    os << "      \"iterations\": " << r.iterations << ",\n";
+    os << "      \"real_time\": " << r.real_ns << ",\n";
+    os << "      \"cpu_time\": " << r.cpu_ns << ",\n";
+    os << "      \"time_unit\": \"ns\"";
+    if (r.items_per_second > 0) {
+      os << ",\n      \"items_per_second\": " << r.items_per_second;
+    }
+    if (r.bytes_per_second > 0) {
+      os << ",\n      \"bytes_per_second\": " << r.bytes_per_second;
+    }
+    if (!r.label.empty()) {
+      os << ",\n      \"label\": \"" << jsonEscape(r.label) << "\"";
+    }
+    os << "\n    }";
+  }
+  os << "\n  ]\n}\n";
+}
+
+bool parseFlag(const char* arg, const char* flag, std::string& value) {
+  const std::size_t len = std::strlen(flag);
+  if (std::strncmp(arg, flag, len) != 0) {
+    return false;
+  }
+  if (arg[len] == '\0') {
+    value.clear();
+    return true;
+  }
+  if (arg[len] != '=') {
+    return false;
+  }
+  value = arg + len + 1;
+  return true;
+}
+
+}
+
+int RunSpecifiedBenchmarks(int argc, char** argv) {
+  std::string filter = ".";
+  double min_time = 0.5;
+  std::string format = "console";
+  std::string out_file;
+  bool list_only = false;
+  std::vector<std::pair<std::string, std::string> > context;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string value;
+    if (parseFlag(argv[i], "--benchmark_filter", value)) {
+      filter = value;
+    } else if (parseFlag(argv[i], "--benchmark_min_time", value)) {
+      min_time = std::atof(value.c_str());
+    } else if (parseFlag(argv[i], "--benchmark_format", value)) {
+      format = value;
+    } else if (parseFlag(argv[i], "--benchmark_out", value)) {
+      out_file = value;
+    } else if (parseFlag(argv[i], "--benchmark_context", value)) {
+      const std::size_t eq = value.find('=');
+      context.push_back(std::make_pair(value.substr(0, eq),
+                                       eq == std::string::npos ?
+                                           "" : value.substr(eq + 1)));
+    } else if (parseFlag(argv[i], "--benchmark_list_tests", value)) {
+      list_only = true;
+    } else {
+      std::cerr << "unrecognized flag: " << argv[i] << "\n";
+      return 1;
+    }
+  }
+  if (format != "console" && format != "json") {
+    std::cerr << "unknown --benchmark_format: " << format << "\n";
+    return 1;
+  }
+
+  const std::regex re(filter);
+  std::vector<std::pair<const Benchmark*, std::vector<std::int64_t> > > all;
+  Runner::instances(all);
+
+  const Runner runner(min_time);
+  std::vector<Result> results;
+  if (format == "console" && !list_only) {
+    char header[256];
+    std::snprintf(header, sizeof(header), "%-48s %15s %15s %12s\n",
+                  "Benchmark", "Time", "CPU", "Iterations");
+    std::cout << header << std::string(93, '-') << "\n";
+  }
+  for (std::size_t i = 0; i < all.size(); ++i) {
+    const std::string name = Runner::instanceName(*all[i].first,
+                                                  all[i].second);
+    if (!std::regex_search(name, re)) {
+      continue;
+    }
+    if (list_only) {
+      std::cout << name << "\n";
+      continue;
+    }
+    results.push_back(runner.run(*all[i].first, all[i].second, name));
+    if (format == "console") {
+      printConsole(std::cout, results.back());
+      std::cout.flush();
+    }
+  }
+  if (list_only) {
+    return 0;
+  }
+
+  if (format == "json") {
+    printJson(std::cout, results, context);
+  }
+  if (!out_file.empty()) {
+    std::ofstream out(out_file.c_str());
+    if (!out) {
+      std::cerr << "could not open " << out_file << "\n";
+      return 1;
+    }
+    printJson(out, results, context);
+  }
+  return 0;
+}
+
+}
+}
+
+int main(int argc, char** argv) {
+  return badgerdb::bench::RunSpecifiedBenchmarks(argc, argv);
+}
@@ -0,0 +1,244 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+namespace bench {
+
+/**
+ * @brief Per-run state handed to a benchmark function.
+ *
+ * This is a small, self-contained subset of the Google Benchmark API so the
+ * suite builds offline.  A benchmark does its setup, then loops on
+ * KeepRunning(); only the time spent inside that loop is measured:
+ * @code
+ *   static void BM_Something(State& state) {
+ *     ... setup ...
+ *     while (state.KeepRunning()) {
+ *       ... measured work ...
+ *     }
+ *     state.SetItemsProcessed(state.iterations());
+ *   }
+ *   BENCHMARK(BM_Something)->Arg(8)->Arg(64);
+ * @endcode
+ *
+ * @warning This class is not threadsafe.
+ */
+class State {
+ public:
+  /**
+   * Constructs the state for one run of a benchmark.
+   *
+   * @param max_iterations  Number of times KeepRunning() returns true.
+   * @param args            Arguments of this benchmark instance.
+   */
+  State(const std::int64_t max_iterations,
+        const std::vector<std::int64_t>& args);
+
+  /**
+   * Returns true while more iterations should be run.  Starts the timer on
+   * the first call and stops it once the iteration budget is used up.
+   */
+  bool KeepRunning() {
+    if (remaining_ > 0) {
+      if (!started_) {
+        started_ = true;
+        ResumeTiming();
+      }
+      --remaining_;
+      return true;
+    }
+    if (started_ && running_) {
+      PauseTiming();
+    }
+    return false;
+  }
+
+  /**
+   * Stops the timer, e.g. to exclude per-iteration setup from the result.
+   */
+  void PauseTiming();
+
+  /**
+   * Restarts the timer after PauseTiming().
+   */
+  void ResumeTiming();
+
+  /**
+   * Returns the i-th argument of this benchmark instance.
+   *
+   * @param i   Index of argument.
+   * @return  Argument value.
+   */
+  std::int64_t range(const std::size_t i = 0) const { return args_.at(i); }
+
+  /**
+   * Returns the number of iterations this run was asked to perform.
+   */
+  std::int64_t iterations() const { return max_iterations_; }
+
+  /**
+   * Records the number of items processed, reported as items per second.
+   */
+  void SetItemsProcessed(const std::int64_t items) { items_processed_ = items; }
+
+  /**
+   * Records the number of bytes processed, reported as bytes per second.
+   */
+  void SetBytesProcessed(const std::int64_t bytes) { bytes_processed_ = bytes; }
+
+  /**
+   * Attaches a free-form label to the result.
+   */
+  void SetLabel(const std::string& label) { label_ = label; }
+
+  /**
+   * Aborts the benchmark; the result is reported with the given message.
+   */
+  void SkipWithError(const std::string& msg) {
+    error_ = msg;
+    remaining_ = 0;
+  }
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  std::int64_t max_iterations_;
+  std::int64_t remaining_;
+  std::vector<std::int64_t> args_;
+  bool started_;
+  bool running_;
+  Clock::time_point real_start_;
+  std::clock_t cpu_start_;
+  double real_seconds_;
+  double cpu_seconds_;
+  std::int64_t items_processed_;
+  std::int64_t bytes_processed_;
+  std::string label_;
+  std::string error_;
+
+  friend class Runner;
+};
+
+/**
+ * @brief Benchmark function signature.
+ */
+typedef void (*Function)(State&);
+
+/**
+ * Function run once after the last run of a benchmark instance, e.g. to
+ * free what the runs kept for each other; see Benchmark::Teardown().
+ */
+typedef void (*TeardownFunction)(const State&);
+
+/**
+ * @brief A registered benchmark and the argument lists it is run with.
+ */
+class Benchmark {
+ public:
+  Benchmark(const std::string& name, Function fn)
+      : name_(name), fn_(fn), teardown_(NULL) {}
+
+  /**
+   * Adds an instance of this benchmark taking a single argument.
+   */
+  Benchmark* Arg(const std::int64_t a) {
+    args_.push_back(std::vector<std::int64_t>(1, a));
+    return this;
+  }
+
+  /**
+   * Adds an instance of this benchmark taking several arguments.
+   */
+  Benchmark* Args(const std::vector<std::int64_t>& a) {
+    args_.push_back(a);
+    return this;
+  }
+
+  /**
+   * Adds an instance for every power of <mult> from <lo> to <hi>, inclusive.
+   */
+  Benchmark* Range(std::int64_t lo, const std::int64_t hi,
+                   const std::int64_t mult = 8) {
+    for (; lo < hi; lo *= mult) {
+      Arg(lo);
+    }
+    return Arg(hi);
+  }
+
+  /**
+   * Runs <fn> after each instance of this benchmark is done, with the state
+   * of its last run.
+   */
+  Benchmark* Teardown(TeardownFunction fn) {
+    teardown_ = fn;
+    return this;
+  }
+
+ private:
+  std::string name_;
+  Function fn_;
+  TeardownFunction teardown_;
+  std::vector<std::vector<std::int64_t> > args_;
+
+  friend class Runner;
+};
+
+/**
+ * Registers a benchmark.  Normally called through the BENCHMARK macro.
+ *
+ * @param name  Name the benchmark is reported under.
+ * @param fn    Benchmark function.
+ * @return  The benchmark, so arguments can be chained onto it.
+ */
+Benchmark* RegisterBenchmark(const char* name, Function fn);
+
+/**
+ * Runs all registered benchmarks selected by the command line flags:
+ * <pre>
+ *   --benchmark_filter=REGEX        only run benchmarks whose name matches
+ *   --benchmark_min_time=SECONDS    minimum measured time per benchmark
+ *   --benchmark_format=console|json format written to stdout
+ *   --benchmark_out=FILE            also write JSON results to FILE
+ *   --benchmark_context=KEY=VALUE   extra context recorded in JSON output
+ *   --benchmark_list_tests          list benchmark names and exit
+ * </pre>
+ *
+ * @return  Process exit status.
+ */
+int RunSpecifiedBenchmarks(int argc, char** argv);
+
+/**
+ * Prevents the compiler from optimizing away a value computed by the
+ * benchmark.
+ */
+template <class T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}
+}
+
+#define BADGERDB_BENCH_CONCAT2(a, b) a##b
+#define BADGERDB_BENCH_CONCAT(a, b) BADGERDB_BENCH_CONCAT2(a, b)
+
+/**
+ * Registers <fn> as a benchmark.  Arguments may be chained onto the result,
+ * e.g. BENCHMARK(BM_Foo)->Arg(1)->Arg(8).
+ */
+#define BENCHMARK(fn)                                                   \
+  static ::badgerdb::bench::Benchmark* BADGERDB_BENCH_CONCAT(           \
+      bench_registration_, __LINE__) __attribute__((unused)) =          \
+      ::badgerdb::bench::RegisterBenchmark(#fn, fn)
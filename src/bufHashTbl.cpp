@@ -12,67 +12,65 @@
 #include "exceptions/hash_already_present_exception.h"
 #include "exceptions/hash_not_found_exception.h"
 #include "exceptions/hash_table_exception.h"
+#include "file_registry.h"
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+/**
+ * Name of the file with the given id, for exception messages.
+ */
+static std::string keyFilename(const PageKey key)
+{
+  return FileRegistry::instance().name(pageKeyFile(key));
+}
+
+int BufHashTbl::hash(const PageKey key)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // multiplicative hashing; the high bits of the product mix in both the
+  // file id and the page number
+  const std::uint64_t mixed = key * 0x9E3779B97F4A7C15ull;
+  return (int)((mixed >> 32) % (std::uint64_t)HTSIZE);
 }
 
-BufHashTbl::BufHashTbl(int htSize)
-	: HTSIZE(htSize)
+BufHashTbl::BufHashTbl(const int htSize, const std::uint32_t capacity, MemoryBudget* budget)
+	: HTSIZE(htSize),
+	  ht(budget, MemoryBudget::HASH_TABLE, htSize),
+	  buckets(budget, MemoryBudget::HASH_TABLE, capacity)
 {
-  // allocate an array of pointers to hashBuckets
-  ht = new hashBucket* [htSize];
-  for(int i=0; i < HTSIZE; i++)
-    ht[i] = NULL;
+  // chain heads start out NULL; buckets are returned to the arena, not freed
 }
 
 BufHashTbl::~BufHashTbl()
 {
-  for(int i = 0; i < HTSIZE; i++) {
-    hashBucket* tmpBuf = ht[i];
-    while (ht[i]) {
-      tmpBuf = ht[i];
-      ht[i] = ht[i]->next;
-      delete tmpBuf;
-    }
-  }
-  delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+void BufHashTbl::insert(const PageKey key, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
+  int index = hash(key);
 
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
+    if (tmpBuc->key == key)
+  		throw HashAlreadyPresentException(keyFilename(key), pageKeyPage(key), tmpBuc->frameNo);
     tmpBuc = tmpBuc->next;
   }
 
-  tmpBuc = new hashBucket;
+  tmpBuc = buckets.allocate();
   if (!tmpBuc)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
-  tmpBuc->pageNo = pageNo;
+  tmpBuc->key = key;
   tmpBuc->frameNo = frameNo;
   tmpBuc->next = ht[index];
   ht[index] = tmpBuc;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+void BufHashTbl::lookup(const PageKey key, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
+  int index = hash(key);
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->key == key)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
       return;
@@ -80,25 +78,81 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
     tmpBuc = tmpBuc->next;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  throw HashNotFoundException(keyFilename(key), pageKeyPage(key));
+}
+
+std::size_t BufHashTbl::lookupMany(const PageKey* keys, const std::size_t count, FrameId* frameNos)
+{
+  std::size_t found = 0;
+  int index[LOOKUP_GROUP];
+  hashBucket* tmpBuc[LOOKUP_GROUP];
+
+  for (std::size_t base = 0; base < count; base += LOOKUP_GROUP)
+  {
+    const std::size_t n = count - base < LOOKUP_GROUP ? count - base : LOOKUP_GROUP;
+
+    // hash the whole group first, touching each chain head only to prefetch it
+    for (std::size_t i = 0; i < n; i++)
+    {
+      index[i] = hash(keys[base + i]);
+      __builtin_prefetch(&ht[index[i]]);
+    }
+
+    // by the time the heads are read the first ones have arrived; prefetch the buckets they point to
+    for (std::size_t i = 0; i < n; i++)
+    {
+      tmpBuc[i] = ht[index[i]];
+      if (tmpBuc[i])
+        __builtin_prefetch(tmpBuc[i]);
+    }
+
+    // walk the chains one step at a time, round robin, so a collision in one chain overlaps with the rest
+    std::size_t pending = n;
+    for (std::size_t i = 0; i < n; i++)
+      frameNos[base + i] = NOT_FOUND;
+    while (pending > 0)
+    {
+      pending = 0;
+      for (std::size_t i = 0; i < n; i++)
+      {
+        if (!tmpBuc[i])
+          continue;
+        if (tmpBuc[i]->key == keys[base + i])
+        {
+          frameNos[base + i] = tmpBuc[i]->frameNo;
+          found++;
+          tmpBuc[i] = NULL;
+          continue;
+        }
+        tmpBuc[i] = tmpBuc[i]->next;
+        if (tmpBuc[i])
+        {
+          __builtin_prefetch(tmpBuc[i]);
+          pending++;
+        }
+      }
+    }
+  }
+
+  return found;
 }
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+void BufHashTbl::remove(const PageKey key) {
 
-  int index = hash(file, pageNo);
+  int index = hash(key);
   hashBucket* tmpBuc = ht[index];
   hashBucket* prevBuc = NULL;
 
   while (tmpBuc)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->key == key)
 		{
       if(prevBuc) 
 				prevBuc->next = tmpBuc->next;
       else
 				ht[index] = tmpBuc->next;
 
-      delete tmpBuc;
+      buckets.free(tmpBuc);
       return;
     }
 		else
@@ -108,7 +162,7 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  throw HashNotFoundException(keyFilename(key), pageKeyPage(key));
 }
 
 }
@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include "file.h"
+#include "memory_budget.h"
 
 namespace badgerdb {
 
@@ -16,14 +20,9 @@ namespace badgerdb {
 */
 struct hashBucket {
 	/**
-	 * pointer a file object (more on this below)
+	 * file id and page number within the file, packed into one word
 	 */
-	File *file;
-
-	/**
-	 * page number within a file
-	 */
-	PageId pageNo;
+	PageKey key;
 
 	/**
 	 * frame number of page in the buffer pool
@@ -50,24 +49,57 @@ class BufHashTbl
 	 */
   int HTSIZE;
 	/**
-	 * Actual Hash table object
+	 * Actual Hash table object: the head of each chain
+	 */
+  TrackedArray<hashBucket*> ht;
+
+	/**
+	 * Buckets for the chains, one per entry the table may hold
 	 */
-  hashBucket**  ht;
+  Arena<hashBucket> buckets;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed from the page key
 	 *
-	 * @param file   	File object
-	 * @param pageNo  Page number in the file
+	 * @param key   	File id and page number
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const PageKey key);
 
  public:
 	/**
-   * Constructor of BufHashTbl class
+	 * Frame number lookupMany() reports for keys that are not in the table
+	 */
+  static const FrameId NOT_FOUND = ~(FrameId)0;
+
+	/**
+	 * Number of lookups lookupMany() keeps in flight at once
 	 */
-	BufHashTbl(const int htSize);  // constructor
+  static const std::size_t LOOKUP_GROUP = 16;
+
+	/**
+   * Constructor of BufHashTbl class.  All memory, including the buckets for up to <capacity> entries, is
+   * allocated here and charged to <budget>.
+	 *
+	 * @param htSize   Number of chains
+	 * @param capacity Most entries the table holds at once
+	 * @param budget   Budget the table's memory is reserved against
+   * @throws  MemoryBudgetExceededException if the budget can't cover the table
+	 */
+	BufHashTbl(const int htSize, const std::uint32_t capacity, MemoryBudget* budget);
+
+	/**
+   * Bytes a table of <htSize> chains and <capacity> entries charges to its budget.
+	 */
+  static std::uint64_t bytesFor(const int htSize, const std::uint32_t capacity)
+  {
+    return TrackedArray<hashBucket*>::bytesFor(htSize) + Arena<hashBucket>::bytesFor(capacity);
+  }
+
+	/**
+   * Bytes this table charges to its budget.
+	 */
+  std::uint64_t memoryUsage() const { return ht.bytes() + buckets.bytes(); }
 
 	/**
    * Destructor of BufHashTbl class
@@ -75,35 +107,68 @@ class BufHashTbl
   ~BufHashTbl(); // destructor
 	
 	/**
-   * Insert entry into hash table mapping (file, pageNo) to frameNo.
+   * Insert entry into hash table mapping key to frameNo.
 	 *
-	 * @param file   	File object
-	 * @param pageNo 	Page number in the file
+	 * @param key   	File id and page number
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as running of memory
+   * @throws  HashTableException if the table already holds as many entries as its capacity
 	 */
-  void insert(const File* file, const PageId pageNo, const FrameId frameNo);
+  void insert(const PageKey key, const FrameId frameNo);
 
 	/**
-   * Check if (file, pageNo) is currently in the buffer pool (ie. in
-   * the hash table).
+   * Check if key is currently in the buffer pool (ie. in the hash table).
 	 *
-	 * @param file  	File object
-	 * @param pageNo	Page number in the file
+	 * @param key   	File id and page number
 	 * @param frameNo Frame number reference
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
-  void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
+  void lookup(const PageKey key, FrameId &frameNo);
 
 	/**
-   * Delete entry (file,pageNo) from hash table.
+   * Look up many keys at once.  Lookups are interleaved in groups of LOOKUP_GROUP, prefetching each key's
+   * chain head and buckets while the others are being hashed and compared, so that the cache misses of a
+   * group overlap instead of being taken one after another.  Keys that are absent are reported as NOT_FOUND
+   * rather than by an exception.
 	 *
-	 * @param file   	File object
-	 * @param pageNo  Page number in the file
+	 * @param keys     File ids and page numbers to look up
+	 * @param count    Number of keys
+	 * @param frameNos Frame number of each key, or NOT_FOUND, returned via this array
+	 * @return Number of keys found
+	 */
+  std::size_t lookupMany(const PageKey* keys, const std::size_t count, FrameId* frameNos);
+
+	/**
+   * Delete entry key from hash table.
+	 *
+	 * @param key   	File id and page number
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void remove(const PageKey key);
+
+	/**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo.
+	 */
+  void insert(const File* file, const PageId pageNo, const FrameId frameNo)
+  {
+    insert(makePageKey(file->id(), pageNo), frameNo);
+  }
+
+	/**
+   * Check if (file, pageNo) is currently in the buffer pool.
+	 */
+  void lookup(const File* file, const PageId pageNo, FrameId &frameNo)
+  {
+    lookup(makePageKey(file->id(), pageNo), frameNo);
+  }
+
+	/**
+   * Delete entry (file,pageNo) from hash table.
+	 */
+  void remove(const File* file, const PageId pageNo)
+  {
+    remove(makePageKey(file->id(), pageNo));
+  }
 };
 
 }
@@ -6,14 +6,24 @@
  * Partial copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <memory>
 #include <iostream>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
 #include "buffer.h"
+#include "io_executor.h"
+#include "trace.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 /**
  * @brief Class for maintaining badgerdb
@@ -26,13 +36,23 @@ namespace badgerdb
 	 * sets the values.
 	 * Also creates a pool of frames for the buffer manager to hold pages
 	 * Also creates a hash table to store the frames
+	 * All of it is reserved against the memory budget first
 	 *
 	 * @param bufs Number of buffer frames to be created
+	 * @param sharedBudget Budget to reserve the memory against, or NULL for one of the pool's own
 	 */
-	BufMgr::BufMgr(std::uint32_t bufs)
-		: numBufs(bufs)
+	BufMgr::BufMgr(std::uint32_t bufs, MemoryBudget* sharedBudget)
+		: ownBudget(sharedBudget == NULL ? new MemoryBudget() : NULL),
+		  budget(sharedBudget == NULL ? ownBudget.get() : sharedBudget),
+		  selfReservation(budget, MemoryBudget::OTHER, sizeof(BufMgr)),
+		  descs(budget, MemoryBudget::DESCRIPTORS, bufs),
+		  frames(budget, MemoryBudget::FRAMES, bufs),
+		  numBufs(bufs),
+		  fileChains(budget, MemoryBudget::HASH_TABLE, hashTableSize(bufs)),
+		  fileEntries(budget, MemoryBudget::HASH_TABLE, bufs),
+		  flushThreads(DEFAULT_FLUSH_THREADS)
 	{
-		bufDescTable = new BufDesc[bufs];
+		bufDescTable = descs.data();
 
 		for (FrameId i = 0; i < bufs; i++)
 		{
@@ -40,12 +60,54 @@ namespace badgerdb
 			bufDescTable[i].valid = false;
 		}
 
-		bufPool = new Page[bufs];
+		bufPool = frames.data();
 
-		int htsize = ((((int)(bufs * 1.2)) * 2) / 2) + 1;
-		hashTable = new BufHashTbl(htsize); // allocate the buffer hash table
+		// allocate the buffer hash table; it never holds more entries than there are frames
+		hashTable.reset(new BufHashTbl(hashTableSize(bufs), bufs, budget));
 
 		clockHand = bufs - 1;
+		windowHead = windowQueued = windowCount = windowTarget = 0;
+		writeHead = writesQueued = 0;
+		writerStop = false;
+		ioInFlight = allocWaiters = 0;
+		victimHead = victimsCached = 0;
+		evictionBatch = DEFAULT_EVICTION_BATCH;
+	}
+
+	std::uint64_t BufMgr::bytesForFrames(std::uint32_t bufs)
+	{
+		return sizeof(BufMgr) + TrackedArray<BufDesc>::bytesFor(bufs) + TrackedArray<Page>::bytesFor(bufs) +
+			   BufHashTbl::bytesFor(hashTableSize(bufs), bufs) + TrackedArray<FileFrames *>::bytesFor(hashTableSize(bufs)) +
+			   Arena<FileFrames>::bytesFor(bufs);
+	}
+
+	std::uint32_t BufMgr::framesForBudget(std::uint64_t bytes)
+	{
+		// bytesForFrames grows with the number of frames, so search for the largest count that fits
+		std::uint64_t low = 0;
+		std::uint64_t high = bytes / sizeof(Page) + 1;
+		if (high > UINT32_MAX)
+			high = UINT32_MAX;
+		while (low < high)
+		{
+			const std::uint64_t mid = low + (high - low + 1) / 2;
+			if (bytesForFrames((std::uint32_t)mid) <= bytes)
+				low = mid;
+			else
+				high = mid - 1;
+		}
+		return (std::uint32_t)low;
+	}
+
+	std::uint64_t BufMgr::memoryUsage() const
+	{
+		std::uint64_t bytes = selfReservation.bytes() + descs.bytes() + frames.bytes() + hashTable->memoryUsage() +
+							  fileChains.bytes() + fileEntries.bytes();
+		if (sketch)
+			bytes += sketch->bytes() + windowQueue->bytes();
+		if (writeQueue)
+			bytes += writeQueue->bytes();
+		return bytes;
 	}
 
 	/**
@@ -53,17 +115,407 @@ namespace badgerdb
 	 */
 	BufMgr::~BufMgr()
 	{
-		for (FrameId i = 0; i < BufMgr::numBufs; i++) // for each Frame
+		stopBackgroundWriter();
+		try
+		{
+			flushAllDirty();
+		}
+		catch (const std::exception &e)
 		{
-			if (bufDescTable[i].file != NULL && bufDescTable[i].file->isOpen(bufDescTable[i].file->filename()) && bufDescTable[i].dirty == true)
+			// destructors must not throw; report and carry on releasing memory
+			std::cerr << "BufMgr: writing back dirty pages failed: " << e.what() << "\n";
+		}
+	}
+
+	/**
+	 * @brief Write a dirty frame back to its file.  The frame only records the file id, so the write goes through
+	 * a reference taken from the file registry; if no File object has the file open any more the page is dropped.
+	 *
+	 * @param frame  Frame to write back
+	 * @return True if the page was written
+	 */
+	bool BufMgr::writeBack(FrameId frame)
+	{
+		FileRegistry::Entry *entry = FileRegistry::instance().tryAcquire(bufDescTable[frame].fileId());
+		if (entry == NULL)
+		{
+			return false;
+		}
+		File file(entry); // adopts the reference
+		BADGERDB_TRACE3(buf__writeback, file.id(), bufDescTable[frame].pageNo(), frame);
+		std::shared_lock<std::shared_mutex> structure(fileLatch);
+		file.writePage(bufPool[frame], bufDescTable[frame].linkVersion);
+		return true;
+	}
+
+	/**
+	 * @brief Write a dirty frame back with the latch released.  The frame stays in the hash table, marked
+	 * IO_WRITE, so threads wanting its page wait for the write instead of reading the old version from disk.
+	 *
+	 * @param lock  Lock on the pool latch
+	 * @param frame  Frame to write back
+	 * @return True if the page was written
+	 */
+	bool BufMgr::writeBackUnlatched(std::unique_lock<std::mutex> &lock, FrameId frame)
+	{
+		bufDescTable[frame].io = BufDesc::IO_WRITE;
+		ioInFlight++;
+		lock.unlock();
+		bool written;
+		try
+		{
+			written = writeBack(frame);
+		}
+		catch (...)
+		{
+			// the page stays dirty
+			lock.lock();
+			ioInFlight--;
+			finishIo(frame);
+			throw;
+		}
+		lock.lock();
+		ioInFlight--;
+		if (written)
+			bufStats.diskwrites++;
+		bufDescTable[frame].dirty = false;
+		finishIo(frame);
+		return written;
+	}
+
+	/**
+	 * @brief Read pages into frames set up for them, with the latch released.  Threads wanting one of the pages
+	 * meanwhile find its frame in the hash table marked IO_READ and wait for it, so each page is read once.
+	 *
+	 * @param lock  Lock on the pool latch
+	 * @param file  File object
+	 * @param pageNos  Page numbers to read
+	 * @param frameNos  Frames to read them into
+	 * @param count  Number of pages
+	 * @throws InvalidPageException If any of the pages does not exist in the file; the frames are freed again
+	 */
+	void BufMgr::readFrames(std::unique_lock<std::mutex> &lock, File *file, const PageId pageNos[],
+							const FrameId frameNos[], std::size_t count)
+	{
+		Page *single[1];
+		std::vector<Page *> many;
+		Page **pages = single;
+		if (count > 1)
+		{
+			many.resize(count);
+			pages = many.data();
+		}
+		for (std::size_t i = 0; i < count; i++)
+		{
+			pages[i] = &bufPool[frameNos[i]];
+		}
+
+		ioInFlight++;
+		lock.unlock();
+		std::uint64_t linkVersion;
+		try
+		{
+			std::shared_lock<std::shared_mutex> structure(fileLatch);
+			linkVersion = file->linkVersion();
+			if (count == 1)
+				file->readPages(pageNos[0], 1, pages);
+			else
+				file->readPages(std::vector<PageId>(pageNos, pageNos + count), pages);
+		}
+		catch (...)
+		{
+			lock.lock();
+			ioInFlight--;
+			for (std::size_t i = 0; i < count; i++)
 			{
-				bufDescTable[i].file->writePage(bufPool[i]); // write dirty page to disk
-				bufDescTable[i].Clear();
+				BADGERDB_TRACE2(buf__miss__abort, file->id(), pageNos[i]);
+				freeFrame(frameNos[i]);
+				finishIo(frameNos[i]);
 			}
+			throw;
+		}
+		lock.lock();
+		ioInFlight--;
+		bufStats.diskreads += (int)count;
+		for (std::size_t i = 0; i < count; i++)
+		{
+			bufDescTable[frameNos[i]].linkVersion = linkVersion;
+			finishIo(frameNos[i]);
+			BADGERDB_TRACE3(buf__miss__done, file->id(), pageNos[i], frameNos[i]);
+		}
+	}
+
+	/**
+	 * @brief Mark a frame's I/O finished.  Waiters are woken by stripe, so some wake for another frame and go
+	 * back to sleep.  Allocators waiting for any frame to come free are woken too.
+	 */
+	void BufMgr::finishIo(FrameId frame)
+	{
+		bufDescTable[frame].io = BufDesc::IO_NONE;
+		frameIoDone[frame % IO_WAIT_STRIPES].notify_all();
+		if (allocWaiters > 0)
+			allocWake.notify_all();
+	}
+
+	/**
+	 * @brief Wait for a frame's I/O to finish.
+	 */
+	void BufMgr::waitForIo(std::unique_lock<std::mutex> &lock, FrameId frame)
+	{
+		const BufDesc &desc = bufDescTable[frame];
+		frameIoDone[frame % IO_WAIT_STRIPES].wait(lock, [&desc]() { return desc.io == BufDesc::IO_NONE; });
+	}
+
+	/**
+	 * @brief Find the entry listing a file's frames.
+	 */
+	FileFrames *BufMgr::fileFrames(const FileId file)
+	{
+		FileFrames *entry = fileChains[file % fileChains.size()];
+		while (entry != NULL && entry->file != file)
+			entry = entry->next;
+		return entry;
+	}
+
+	/**
+	 * @brief Push a frame onto the front of its file's list, creating the list if it is the file's first frame.
+	 */
+	void BufMgr::linkFrame(FrameId frame)
+	{
+		BufDesc &desc = bufDescTable[frame];
+		const FileId file = desc.fileId();
+		FileFrames *entry = fileFrames(file);
+		if (entry == NULL)
+		{
+			// never fails: each entry holds at least one of the frames
+			entry = fileEntries.allocate();
+			FileFrames *&chain = fileChains[file % fileChains.size()];
+			entry->file = file;
+			entry->head = NO_FRAME;
+			entry->count = 0;
+			entry->next = chain;
+			chain = entry;
 		}
-		delete[] bufDescTable;
-		delete[] bufPool;
-		delete hashTable;
+		desc.filePrev = NO_FRAME;
+		desc.fileNext = entry->head;
+		if (entry->head != NO_FRAME)
+			bufDescTable[entry->head].filePrev = frame;
+		entry->head = frame;
+		entry->count++;
+	}
+
+	/**
+	 * @brief Unlink a frame from its file's list, dropping the list when it empties.
+	 */
+	void BufMgr::unlinkFrame(FrameId frame)
+	{
+		BufDesc &desc = bufDescTable[frame];
+		const FileId file = desc.fileId();
+		FileFrames *&chain = fileChains[file % fileChains.size()];
+		FileFrames *prevEntry = NULL;
+		FileFrames *entry = chain;
+		while (entry->file != file)
+		{
+			prevEntry = entry;
+			entry = entry->next;
+		}
+		if (desc.filePrev != NO_FRAME)
+			bufDescTable[desc.filePrev].fileNext = desc.fileNext;
+		else
+			entry->head = desc.fileNext;
+		if (desc.fileNext != NO_FRAME)
+			bufDescTable[desc.fileNext].filePrev = desc.filePrev;
+		desc.filePrev = desc.fileNext = NO_FRAME;
+		if (--entry->count == 0)
+		{
+			if (prevEntry != NULL)
+				prevEntry->next = entry->next;
+			else
+				chain = entry->next;
+			fileEntries.free(entry);
+		}
+	}
+
+	/**
+	 * @brief Give a free frame to a page.
+	 */
+	void BufMgr::assignFrame(FrameId frame, File *file, const PageId pageNo)
+	{
+		bufDescTable[frame].Set(file, pageNo);
+		hashTable->insert(bufDescTable[frame].key, frame);
+		linkFrame(frame);
+	}
+
+	/**
+	 * @brief Take a page out of the pool, leaving its frame free.
+	 */
+	void BufMgr::freeFrame(FrameId frame)
+	{
+		hashTable->remove(bufDescTable[frame].key);
+		leaveWindow(frame);
+		unlinkFrame(frame);
+		bufDescTable[frame].Clear();
+	}
+
+	/**
+	 * @brief Pin a page, reading it into a new frame on a miss.  A page found undergoing I/O is waited for and
+	 * looked up again, since a write-back ends with the page evicted and a failed read with it gone.
+	 *
+	 * @param lock  Lock on the pool latch
+	 * @param file  File object
+	 * @param pageNo  Page number in the file
+	 * @return Frame holding the page, pinned
+	 */
+	FrameId BufMgr::fetchPage(std::unique_lock<std::mutex> &lock, File *file, const PageId pageNo)
+	{
+		const PageKey key = makePageKey(file->id(), pageNo);
+		while (1)
+		{
+			FrameId frame = findFrame(key);
+			if (frame != BufHashTbl::NOT_FOUND)
+			{
+				if (bufDescTable[frame].io != BufDesc::IO_NONE)
+				{
+					bufStats.ioWaits++;
+					waitForIo(lock, frame);
+					continue;
+				}
+				// page is in buffer pool
+				BADGERDB_TRACE3(buf__hit, file->id(), pageNo, frame);
+				bufDescTable[frame].refbit = true;
+				bufDescTable[frame].pinCnt++;
+				return frame;
+			}
+
+			// page not in buffer pool
+			BADGERDB_TRACE2(buf__miss__start, file->id(), pageNo);
+			try
+			{
+				if (allocBuf(lock, frame) && findFrame(key) != BufHashTbl::NOT_FOUND)
+				{
+					// another thread read it in while the latch was released; the frame found stays free
+					BADGERDB_TRACE2(buf__miss__abort, file->id(), pageNo);
+					continue;
+				}
+			}
+			catch (...)
+			{
+				BADGERDB_TRACE2(buf__miss__abort, file->id(), pageNo);
+				throw;
+			}
+			assignFrame(frame, file, pageNo);
+			bufDescTable[frame].io = BufDesc::IO_READ;
+			readFrames(lock, file, &pageNo, &frame, 1);
+			return frame;
+		}
+	}
+
+	/**
+	 * @brief Write back all dirty frames on shutdown.  Sorting the (file id, page) keys groups frames by file and
+	 * orders them by page number within it, so each batch is a sequential run of writes to one file.  Batches are
+	 * handed to an I/O thread pool, and flushProgress is called while they run.
+	 */
+	void BufMgr::flushAllDirty()
+	{
+		// enough pages per batch to amortize handing it to a thread, few enough to keep all threads busy
+		const std::size_t FLUSH_BATCH = 256;
+
+		std::vector<std::pair<PageKey, FrameId> > dirty;
+		for (FrameId i = 0; i < numBufs; i++)
+		{
+			if (bufDescTable[i].valid == true && bufDescTable[i].dirty == true)
+			{
+				dirty.push_back(std::make_pair(bufDescTable[i].key, i));
+			}
+		}
+		std::sort(dirty.begin(), dirty.end());
+
+		// one reference to each file for the whole flush; pages of files nobody has open any more are dropped
+		struct Batch
+		{
+			File *file;
+			std::size_t begin, end;
+		};
+		std::vector<std::unique_ptr<File> > files;
+		std::vector<Batch> batches;
+		std::uint64_t total = 0;
+		for (std::size_t begin = 0; begin < dirty.size();)
+		{
+			const FileId fileId = pageKeyFile(dirty[begin].first);
+			std::size_t end = begin;
+			while (end < dirty.size() && pageKeyFile(dirty[end].first) == fileId)
+				end++;
+			FileRegistry::Entry *entry = FileRegistry::instance().tryAcquire(fileId);
+			if (entry != NULL)
+			{
+				files.push_back(std::unique_ptr<File>(new File(entry)));
+				for (std::size_t b = begin; b < end; b += FLUSH_BATCH)
+				{
+					Batch batch = {files.back().get(), b, std::min(end, b + FLUSH_BATCH)};
+					batches.push_back(batch);
+				}
+				total += end - begin;
+			}
+			begin = end;
+		}
+
+		std::atomic<std::uint64_t> written(0);
+		auto writeBatch = [this, &dirty, &written](const Batch &batch) {
+			for (std::size_t k = batch.begin; k < batch.end; k++)
+			{
+				const FrameId frame = dirty[k].second;
+				BADGERDB_TRACE3(buf__writeback, batch.file->id(), bufDescTable[frame].pageNo(), frame);
+				batch.file->writePage(bufPool[frame], bufDescTable[frame].linkVersion);
+				written.fetch_add(1, std::memory_order_relaxed);
+			}
+		};
+
+		const std::chrono::milliseconds REPORT_INTERVAL(500);
+		if (flushThreads <= 1 || batches.size() <= 1)
+		{
+			// Like the executor: a failed batch doesn't stop the others, and the first error is rethrown at the end.
+			std::exception_ptr firstError;
+			std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+			for (std::size_t b = 0; b < batches.size(); b++)
+			{
+				try
+				{
+					writeBatch(batches[b]);
+				}
+				catch (...)
+				{
+					if (!firstError)
+						firstError = std::current_exception();
+				}
+				if (flushProgress && std::chrono::steady_clock::now() - lastReport >= REPORT_INTERVAL)
+				{
+					flushProgress(written.load(), total);
+					lastReport = std::chrono::steady_clock::now();
+				}
+			}
+			if (firstError)
+				std::rethrow_exception(firstError);
+		}
+		else
+		{
+			IoExecutor io(std::min<std::size_t>(flushThreads, batches.size()));
+			for (std::size_t b = 0; b < batches.size(); b++)
+			{
+				const Batch batch = batches[b];
+				io.submit([&writeBatch, batch]() { writeBatch(batch); });
+			}
+			while (!io.waitFor(REPORT_INTERVAL))
+			{
+				if (flushProgress)
+					flushProgress(written.load(), total);
+			}
+		}
+		bufStats.diskwrites += written.load();
+		if (flushProgress && total > 0)
+			flushProgress(written.load(), total);
+
+		for (std::size_t k = 0; k < dirty.size(); k++)
+			bufDescTable[dirty[k].second].dirty = false;
 	}
 
 	/**
@@ -75,54 +527,417 @@ namespace badgerdb
 	}
 
 	/**
-	 * @brief Allocate a new free buffer frame.
+	 * @brief Allocate a new free buffer frame.  Frames undergoing I/O can't be taken, but will be free again
+	 * when it finishes, so if nothing else is free this waits for that rather than giving up.
 	 *
+	 * @param lock  Lock on the pool latch
 	 * @param frame  The frame ID which gets determined after allocation, returned through this variable.
+	 * @return True if the latch was released
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-	void BufMgr::allocBuf(FrameId &frame)
+	bool BufMgr::allocBuf(std::unique_lock<std::mutex> &lock, FrameId &frame)
 	{
-		// find a frame to allocate
+		bool released = false;
+		while (1)
+		{
+			if (sketch)
+			{
+				if (allocBufAdmitted(lock, frame, released))
+					return released;
+			}
+			else if (findMainVictim(frame))
+			{
+				if (bufDescTable[frame].valid == true && evictFrame(lock, frame))
+					released = true;
+				return released;
+			}
+			if (ioInFlight == 0)
+			{
+				// all pages are pinned
+				BADGERDB_TRACE1(buf__exceeded, numBufs);
+				throw BufferExceededException();
+			}
+			allocWaiters++;
+			allocWake.wait(lock);
+			allocWaiters--;
+			released = true;
+		}
+	}
+
+	/**
+	 * @brief Evict the page in a valid, unpinned frame, writing it back first if it is dirty.
+	 *
+	 * @param lock  Lock on the pool latch
+	 * @param frame  Frame to evict
+	 * @return True if the latch was released
+	 */
+	bool BufMgr::evictFrame(std::unique_lock<std::mutex> &lock, FrameId frame)
+	{
+		BADGERDB_TRACE4(buf__evict, bufDescTable[frame].fileId(), bufDescTable[frame].pageNo(), frame,
+						bufDescTable[frame].dirty);
+		// if the frame is dirty, write it back to disk; the caller waits for it, but nobody else does
+		const bool dirty = bufDescTable[frame].dirty;
+		if (dirty)
+		{
+			writeBackUnlatched(lock, frame);
+			bufStats.syncWrites++;
+		}
+		// clean or not, the old page must no longer map to this frame
+		freeFrame(frame);
+		return dirty;
+	}
+
+	/**
+	 * @brief Run the clock over the main region (the whole pool without admission).  Invalid frames are taken
+	 * wherever they are.  A dirty victim would have to be written back before its frame can be reused, so the
+	 * clock moves on for up to DIRTY_SKIP_LIMIT more frames looking for a clean one, queueing the dirty ones it
+	 * passes for the background writer; if it finds none, the first dirty victim is returned.
+	 *
+	 * @param frame  Frame found
+	 * @return False if every frame of the main region is pinned
+	 */
+	bool BufMgr::findMainVictim(FrameId &frame)
+	{
+		while (victimsCached > 0)
+		{
+			const FrameId cached = victimCache[victimHead];
+			victimHead = (victimHead + 1) % MAX_EVICTION_BATCH;
+			victimsCached--;
+			if (isCleanVictim(bufDescTable[cached]))
+			{
+				bufStats.cachedVictims++;
+				frame = cached;
+				return true;
+			}
+		}
+
 		bool foundUnpin = false;
+		bool foundDirty = false;
+		FrameId dirtyFrame = 0;
+		std::uint32_t dirtySkips = 0;
 		FrameId start = clockHand;
 		while (1)
 		{
+			if (foundDirty && ++dirtySkips > DIRTY_SKIP_LIMIT)
+			{
+				frame = dirtyFrame;
+				return true;
+			}
 			advanceClock();
-
-			if (bufDescTable[clockHand].valid == false)
+			BufDesc &desc = bufDescTable[clockHand];
+			if (desc.io != BufDesc::IO_NONE)
+			{
+				// as good as pinned until its I/O is done
+			}
+			else if (desc.valid == false)
 			{
-				// found a frame to allocate since valid bit is false
 				frame = clockHand;
-				return;
+				harvestVictims();
+				return true;
 			}
-			else if (bufDescTable[clockHand].pinCnt == 0)
+			else if (desc.inWindow == false)
 			{
-				foundUnpin = true; // found a potential frame to allocate since pin count is 0
-				if (bufDescTable[clockHand].refbit == false)
+				if (desc.pinCnt == 0)
 				{
-					// if the frame is dirty, write it back to disk
-					if (bufDescTable[clockHand].dirty == true)
+					foundUnpin = true;
+					if (desc.refbit == false)
 					{
-						bufDescTable[clockHand].file->writePage(bufPool[clockHand]);
-						hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-						bufDescTable[clockHand].Clear();
+						if (desc.dirty == false)
+						{
+							frame = clockHand;
+							harvestVictims();
+							return true;
+						}
+						queueWrite(clockHand);
+						if (!foundDirty)
+						{
+							foundDirty = true;
+							dirtyFrame = clockHand;
+						}
 					}
-
-					frame = clockHand;
-					return;
 				}
+				desc.refbit = false;
 			}
-			bufDescTable[clockHand].refbit = false;
-			if (clockHand == start) // if we've looped around
+			if (clockHand == start)
+			{
+				if (foundUnpin == false)
+					return false;
+				foundUnpin = false;
+			}
+		}
+	}
+
+	/**
+	 * @brief Carry the clock on past the victim just found for up to twice the eviction batch, applying the same
+	 * rules, and cache the clean victims it passes, so that the next misses take a frame from the cache instead
+	 * of each starting a sweep of their own.  Cached frames stay resident until used; findMainVictim() skips
+	 * those that have been pinned, referenced or dirtied since.
+	 */
+	void BufMgr::harvestVictims()
+	{
+		std::uint32_t scan = 2 * evictionBatch;
+		if (scan > numBufs - 1)
+			scan = numBufs - 1;
+		for (; scan > 0 && victimsCached + 1 < evictionBatch; scan--)
+		{
+			advanceClock();
+			BufDesc &desc = bufDescTable[clockHand];
+			if (desc.io != BufDesc::IO_NONE || (desc.valid == true && desc.inWindow == true))
+				continue;
+			if (isCleanVictim(desc))
 			{
-				if (foundUnpin == false) // Throw exception if all pages are pinned
+				victimCache[(victimHead + victimsCached) % MAX_EVICTION_BATCH] = clockHand;
+				victimsCached++;
+				continue;
+			}
+			if (desc.pinCnt == 0 && desc.refbit == false)
+				queueWrite(clockHand);
+			desc.refbit = false;
+		}
+	}
+
+	/**
+	 * @brief Set the number of victims a sweep of the clock collects.
+	 *
+	 * @param frames  Victims per sweep
+	 */
+	void BufMgr::setEvictionBatch(unsigned frames)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		if (frames < 1)
+			frames = 1;
+		if (frames > MAX_EVICTION_BATCH)
+			frames = MAX_EVICTION_BATCH;
+		evictionBatch = frames;
+		// the cache may hold more than the new batch; it drains as usual
+	}
+
+	/**
+	 * @brief Pop window queue entries until one is an unpinned frame still in the window.  Stale entries are
+	 * dropped; pinned frames and frames undergoing I/O go to the back of the queue.
+	 *
+	 * @param frame  Frame found
+	 * @return False if the window has no unpinned frame
+	 */
+	bool BufMgr::popWindow(FrameId &frame)
+	{
+		TrackedArray<FrameId> &queue = *windowQueue;
+		for (std::uint32_t tries = windowQueued; tries > 0 && windowQueued > 0; tries--)
+		{
+			const FrameId candidate = queue[windowHead];
+			windowHead = (windowHead + 1) % numBufs;
+			windowQueued--;
+			BufDesc &desc = bufDescTable[candidate];
+			if (desc.inWindow && desc.valid == false)
+			{
+				// a read into this frame failed; it is free, and the main clock will find it
+				leaveWindow(candidate);
+			}
+			if (desc.inWindow == false)
+			{
+				desc.queued = false;
+				continue;
+			}
+			if (desc.pinCnt > 0 || desc.io != BufDesc::IO_NONE)
+			{
+				queue[(windowHead + windowQueued) % numBufs] = candidate;
+				windowQueued++;
+				continue;
+			}
+			desc.queued = false;
+			frame = candidate;
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * @brief Put a frame into the window, queueing it unless it still has an old entry in the queue.
+	 */
+	void BufMgr::enterWindow(FrameId frame)
+	{
+		BufDesc &desc = bufDescTable[frame];
+		desc.inWindow = true;
+		windowCount++;
+		if (!desc.queued)
+		{
+			(*windowQueue)[(windowHead + windowQueued) % numBufs] = frame;
+			windowQueued++;
+			desc.queued = true;
+		}
+	}
+
+	/**
+	 * @brief Allocate a frame for a new page, which goes into the admission window.  Once the window is full its
+	 * oldest page is the candidate for the main region and the clock's victim there is the page it would displace;
+	 * the sketch's frequency estimates decide which of the two is evicted.
+	 *
+	 * @param lock  Lock on the pool latch
+	 * @param frame  The frame ID which gets determined after allocation, returned through this variable.
+	 * @param released  Set if the latch was released
+	 * @return False if every frame is pinned or undergoing I/O
+	 */
+	bool BufMgr::allocBufAdmitted(std::unique_lock<std::mutex> &lock, FrameId &frame, bool &released)
+	{
+		FrameId victim;
+		const bool haveVictim = findMainVictim(victim);
+		if (haveVictim && bufDescTable[victim].valid == false)
+		{
+			// the pool is not full yet; the window overflows into the main region without evicting anything
+			leaveWindow(victim);
+			frame = victim;
+			enterWindow(frame);
+			FrameId oldest;
+			if (windowCount > windowTarget && popWindow(oldest))
+				leaveWindow(oldest);
+			return true;
+		}
+
+		FrameId candidate;
+		const bool haveCandidate = windowCount >= windowTarget && popWindow(candidate);
+		if (haveCandidate && haveVictim)
+		{
+			if (sketch->frequency(bufDescTable[candidate].key) > sketch->frequency(bufDescTable[victim].key))
+			{
+				// the candidate has been used more: it moves to the main region in place of the victim
+				leaveWindow(candidate);
+				released |= evictFrame(lock, victim);
+				frame = victim;
+			}
+			else
+			{
+				BADGERDB_TRACE2(buf__reject, bufDescTable[candidate].fileId(), bufDescTable[candidate].pageNo());
+				bufStats.rejections++;
+				released |= evictFrame(lock, candidate);
+				frame = candidate;
+			}
+		}
+		else if (haveVictim)
+		{
+			// window not full yet, or all of it pinned
+			released |= evictFrame(lock, victim);
+			frame = victim;
+		}
+		else if (haveCandidate || popWindow(candidate))
+		{
+			// main region all pinned
+			released |= evictFrame(lock, candidate);
+			frame = candidate;
+		}
+		else
+		{
+			return false;
+		}
+		enterWindow(frame);
+		return true;
+	}
+
+	/**
+	 * @brief Turn on TinyLFU admission with a window of windowPercent percent of the frames.
+	 *
+	 * @param windowPercent  Size of the window as a percentage of the frames
+	 * @throws MemoryBudgetExceededException If the budget can't cover the sketch
+	 */
+	void BufMgr::enableAdmission(unsigned windowPercent)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		if (sketch)
+			return;
+		std::unique_ptr<TrackedArray<FrameId> > queue(new TrackedArray<FrameId>(budget, MemoryBudget::DESCRIPTORS, numBufs));
+		sketch.reset(new FrequencySketch(budget, numBufs));
+		windowQueue = std::move(queue);
+		windowTarget = (std::uint32_t)((std::uint64_t)numBufs * windowPercent / 100);
+		if (windowTarget == 0)
+			windowTarget = 1;
+		// pages already resident stay in the main region
+	}
+
+	/**
+	 * @brief Queue a dirty frame for the background writer, if it is running and the frame isn't queued already.
+	 *
+	 * @param frame  Frame to write back
+	 */
+	void BufMgr::queueWrite(FrameId frame)
+	{
+		if (!writeQueue || bufDescTable[frame].writeQueued)
+			return;
+		(*writeQueue)[(writeHead + writesQueued) % numBufs] = frame;
+		writesQueued++;
+		bufDescTable[frame].writeQueued = true;
+		writerWake.notify_one();
+	}
+
+	/**
+	 * @brief Body of the background writer thread.  It holds the latch except while waiting and writing, and
+	 * gives it up between pages.  A queued frame is written only if it is still dirty and unpinned when its turn
+	 * comes; frames reused since are written if their new page is, which does no harm.
+	 */
+	void BufMgr::runBackgroundWriter()
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		while (1)
+		{
+			writerWake.wait(lock, [this]() { return writerStop || writesQueued > 0; });
+			if (writerStop)
+				return;
+			const FrameId frame = (*writeQueue)[writeHead];
+			writeHead = (writeHead + 1) % numBufs;
+			writesQueued--;
+			BufDesc &desc = bufDescTable[frame];
+			desc.writeQueued = false;
+			if (desc.valid == true && desc.dirty == true && desc.pinCnt == 0 && desc.io == BufDesc::IO_NONE)
+			{
+				try
 				{
-					throw BufferExceededException();
+					writeBackUnlatched(lock, frame);
+					bufStats.backgroundWrites++;
+				}
+				catch (const std::exception &e)
+				{
+					// leave the page dirty; evicting it will write it again and report the error to the caller
+					bufStats.backgroundWriteErrors++;
+					std::cerr << "BufMgr: background write-back failed: " << e.what() << "\n";
 				}
-				else
-					foundUnpin = false;
 			}
+			// let waiting threads in before the next write
+			lock.unlock();
+			lock.lock();
+		}
+	}
+
+	/**
+	 * @brief Start the background writer thread.
+	 */
+	void BufMgr::startBackgroundWriter()
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		if (writer.joinable())
+			return;
+		if (!writeQueue)
+			writeQueue.reset(new TrackedArray<FrameId>(budget, MemoryBudget::DESCRIPTORS, numBufs));
+		writeHead = writesQueued = 0;
+		for (FrameId i = 0; i < numBufs; i++)
+			bufDescTable[i].writeQueued = false;
+		writerStop = false;
+		writer = std::thread(&BufMgr::runBackgroundWriter, this);
+	}
+
+	/**
+	 * @brief Stop the background writer thread; pages still queued stay dirty.
+	 */
+	void BufMgr::stopBackgroundWriter()
+	{
+		{
+			std::lock_guard<std::mutex> guard(latch);
+			if (!writer.joinable())
+				return;
+			writerStop = true;
 		}
+		writerWake.notify_one();
+		writer.join();
+		std::lock_guard<std::mutex> guard(latch);
+		// queueWrite() checks for the queue, not the thread
+		writeQueue.reset();
 	}
 
 	/**
@@ -137,25 +952,160 @@ namespace badgerdb
 	 */
 	void BufMgr::readPage(File *file, const PageId pageNo, Page *&page)
 	{
-		FrameId frame;
-		try
+		std::unique_lock<std::mutex> lock(latch);
+		bufStats.accesses++;
+		recordAccess(makePageKey(file->id(), pageNo));
+		page = &bufPool[fetchPage(lock, file, pageNo)];
+	}
+
+	/**
+	 * Pin a page that is already in the buffer pool, without going to disk.
+	 *
+	 * @param file   	File object
+	 * @param PageNo    Page number in the file
+	 * @param page  	Reference to page pointer, set to the frame holding the page if it is resident
+	 * @return True if the page was resident
+	 */
+	bool BufMgr::tryReadPage(File *file, const PageId pageNo, Page *&page)
+	{
+		std::lock_guard<std::mutex> guard(latch);
+		const FrameId frame = findFrame(makePageKey(file->id(), pageNo));
+		if (frame == BufHashTbl::NOT_FOUND || bufDescTable[frame].io != BufDesc::IO_NONE)
 		{
-			hashTable->lookup(file, pageNo, frame);
+			// the caller goes on to readPage(), which counts the access
+			return false;
+		}
+		bufStats.accesses++;
+		recordAccess(makePageKey(file->id(), pageNo));
+		BADGERDB_TRACE3(buf__hit, file->id(), pageNo, frame);
+		bufDescTable[frame].refbit = true;
+		bufDescTable[frame].pinCnt++;
+		page = &bufPool[frame];
+		return true;
+	}
 
-			// page is in buffer pool
-			bufDescTable[frame].refbit = true;
-			bufDescTable[frame].pinCnt++;
-			page = &bufPool[frame];
+	/**
+	 * Reads many pages of a file at once and returns them pinned.
+	 * Resident pages are found with one batched hash table lookup; frames are allocated and pinned for the rest,
+	 * which are then read together.  Pages another thread is reading or writing back, and pages listed twice,
+	 * are left until that read is done, since waiting for them before it could deadlock.  On failure every pin
+	 * taken here is dropped and every frame allocated here is freed again.
+	 *
+	 * @param file   	File object
+	 * @param pageNos   Page numbers in the file to be read
+	 * @param pages  	Array of page pointers, pages[i] set to the frame holding pageNos[i]
+	 * @throws BufferExceededException If the pool runs out of frames to read the missing pages into
+	 * @throws InvalidPageException If any of the pages does not exist in the file
+	 */
+	void BufMgr::readPages(File *file, const std::vector<PageId> &pageNos, Page *pages[])
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		const std::size_t count = pageNos.size();
+		std::vector<PageKey> keys(count);
+		std::vector<FrameId> found(count);
+		for (std::size_t i = 0; i < count; i++)
+		{
+			keys[i] = makePageKey(file->id(), pageNos[i]);
 		}
-		catch (HashNotFoundException e)
+		hashTable->lookupMany(keys.data(), count, found.data());
+
+		// the descriptors of resident pages are written next; start fetching them now
+		for (std::size_t i = 0; i < count; i++)
 		{
+			if (found[i] != BufHashTbl::NOT_FOUND)
+			{
+				__builtin_prefetch(&bufDescTable[found[i]], 1);
+			}
+		}
 
-			// page not in buffer pool
-			allocBuf(frame);
-			bufPool[frame] = file->readPage(pageNo);
-			bufDescTable[frame].Set(file, pageNo);
-			hashTable->insert(file, pageNo, frame);
-			page = &bufPool[frame];
+		std::vector<FrameId> pinned;
+		std::vector<FrameId> fresh;
+		std::vector<PageId> missing;
+		std::vector<std::size_t> deferred;
+		// set until the fresh frames are handed to readFrames(), which frees them itself if the read fails
+		bool freshUnread = true;
+		try
+		{
+			for (std::size_t i = 0; i < count; i++)
+			{
+				bufStats.accesses++;
+				recordAccess(keys[i]);
+				FrameId frame = found[i];
+				// found[] may be out of date once allocBuf() has released the latch, and a page missing twice
+				// in one batch gets its frame the first time
+				if (frame == BufHashTbl::NOT_FOUND || bufDescTable[frame].key != keys[i] ||
+					bufDescTable[frame].valid == false)
+				{
+					frame = findFrame(keys[i]);
+				}
+				if (frame == BufHashTbl::NOT_FOUND)
+				{
+					BADGERDB_TRACE2(buf__miss__start, file->id(), pageNos[i]);
+					bool raced;
+					try
+					{
+						raced = allocBuf(lock, frame) && findFrame(keys[i]) != BufHashTbl::NOT_FOUND;
+					}
+					catch (...)
+					{
+						BADGERDB_TRACE2(buf__miss__abort, file->id(), pageNos[i]);
+						throw;
+					}
+					if (raced)
+					{
+						// another thread read it in while the latch was released; the frame found stays free
+						BADGERDB_TRACE2(buf__miss__abort, file->id(), pageNos[i]);
+						deferred.push_back(i);
+						continue;
+					}
+					// pinned by assignFrame(), so allocating frames for the rest of the batch can't evict it
+					assignFrame(frame, file, pageNos[i]);
+					bufDescTable[frame].io = BufDesc::IO_READ;
+					fresh.push_back(frame);
+					missing.push_back(pageNos[i]);
+				}
+				else if (bufDescTable[frame].io != BufDesc::IO_NONE)
+				{
+					deferred.push_back(i);
+					continue;
+				}
+				else
+				{
+					BADGERDB_TRACE3(buf__hit, file->id(), pageNos[i], frame);
+					bufDescTable[frame].refbit = true;
+					bufDescTable[frame].pinCnt++;
+					pinned.push_back(frame);
+				}
+				pages[i] = &bufPool[frame];
+			}
+
+			freshUnread = false;
+			if (!missing.empty())
+			{
+				readFrames(lock, file, missing.data(), fresh.data(), fresh.size());
+			}
+			pinned.insert(pinned.end(), fresh.begin(), fresh.end());
+
+			for (std::size_t d = 0; d < deferred.size(); d++)
+			{
+				const FrameId frame = fetchPage(lock, file, pageNos[deferred[d]]);
+				pinned.push_back(frame);
+				pages[deferred[d]] = &bufPool[frame];
+			}
+		}
+		catch (...)
+		{
+			for (std::size_t i = 0; i < pinned.size(); i++)
+			{
+				bufDescTable[pinned[i]].pinCnt--;
+			}
+			for (std::size_t i = 0; freshUnread && i < fresh.size(); i++)
+			{
+				BADGERDB_TRACE2(buf__miss__abort, file->id(), missing[i]);
+				freeFrame(fresh[i]);
+				finishIo(fresh[i]);
+			}
+			throw;
 		}
 	}
 
@@ -169,6 +1119,7 @@ namespace badgerdb
 	 */
 	void BufMgr::unPinPage(File *file, const PageId pageNo, const bool dirty)
 	{
+		std::lock_guard<std::mutex> guard(latch);
 		FrameId frame;
 		try
 		{
@@ -176,7 +1127,7 @@ namespace badgerdb
 
 			if (bufDescTable[frame].pinCnt == 0) // Throw exception if Page is already unpinned
 			{
-				throw PageNotPinnedException(bufDescTable[frame].file->filename(), pageNo, frame);
+				throw PageNotPinnedException(bufDescTable[frame].filename(), pageNo, frame);
 			}
 
 			bufDescTable[frame].pinCnt--;
@@ -190,10 +1141,46 @@ namespace badgerdb
 		}
 	}
 
+	/**
+	 * Wait out I/O on the frames of a file and check none is pinned.  Only unpinned frames undergo write-backs,
+	 * and a frame being read is pinned, so after a wait the file's list is walked again from the start: the frame
+	 * waited for may have been evicted, or another thread may have read pages of the file in meanwhile.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param file   	File object
+	 * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+	 */
+	void BufMgr::settleFile(std::unique_lock<std::mutex> &lock, const File *file, const PageId firstPage)
+	{
+		FileFrames *entry = fileFrames(file->id());
+		FrameId frame = entry == NULL ? NO_FRAME : entry->head;
+		while (frame != NO_FRAME)
+		{
+			const BufDesc &desc = bufDescTable[frame];
+			if (desc.pageNo() < firstPage)
+			{
+				frame = desc.fileNext;
+				continue;
+			}
+			if (desc.pinCnt > 0)
+			{
+				throw PagePinnedException(desc.filename(), desc.pageNo(), frame);
+			}
+			if (desc.io != BufDesc::IO_NONE)
+			{
+				waitForIo(lock, frame);
+				entry = fileFrames(file->id());
+				frame = entry == NULL ? NO_FRAME : entry->head;
+				continue;
+			}
+			frame = desc.fileNext;
+		}
+	}
+
 	/**
 	 * Writes out all dirty pages of the file to disk.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
+	 * Otherwise Error returned.  Frames are found through the file's frame list, and dirty pages written in page order.
 	 *
 	 * @param file   	File object
 	 * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
@@ -201,31 +1188,97 @@ namespace badgerdb
 	 */
 	void BufMgr::flushFile(const File *file)
 	{
-		// Check for each frame belonging to the file being flushed in the pool
-		for (FrameId i = 0; i < numBufs; i++)
+		std::unique_lock<std::mutex> lock(latch);
+		// Frames are listed by file id, so pages read through any File object for the same file are flushed.
+		settleFile(lock, file);
+		FileFrames *entry = fileFrames(file->id());
+		if (entry == NULL)
 		{
-			if (bufDescTable[i].file == file)
+			return;
+		}
+
+		std::vector<std::pair<PageId, FrameId> > dirty;
+		for (FrameId i = entry->head; i != NO_FRAME; i = bufDescTable[i].fileNext)
+		{
+			if (bufDescTable[i].valid == false)
 			{
-				if (bufDescTable[i].valid == false)
-				{
-					throw BadBufferException(i, bufDescTable[i].dirty, bufDescTable[i].valid, bufDescTable[i].refbit);
-				}
-				if (bufDescTable[i].pinCnt > 0)
-				{
-					throw PagePinnedException(bufDescTable[i].file->filename(), bufDescTable[i].pageNo, i);
-				}
-				// if page in frame is dirty, write it back to disk
-				if (bufDescTable[i].dirty == true)
-				{
-					// bufDescTable[i].file->writePage(bufDescTable[i].pageNo, bufPool[i]);
-					bufDescTable[i].file->writePage(bufPool[i]);
-					bufDescTable[i].dirty = false;
-				}
-				// remove the page from the hash table and out of the buffer pool
-				hashTable->remove(bufDescTable[i].file, bufDescTable[i].pageNo);
-				bufDescTable[i].Clear();
+				throw BadBufferException(i, bufDescTable[i].dirty, bufDescTable[i].valid, bufDescTable[i].refbit);
+			}
+			if (bufDescTable[i].dirty == true)
+			{
+				dirty.push_back(std::make_pair(bufDescTable[i].pageNo(), i));
+			}
+		}
+		std::sort(dirty.begin(), dirty.end());
+		// if page in frame is dirty, write it back to disk
+		for (std::size_t k = 0; k < dirty.size(); k++)
+		{
+			if (writeBack(dirty[k].second))
+				bufStats.diskwrites++;
+			bufDescTable[dirty[k].second].dirty = false;
+		}
+		// remove the pages from the hash table and out of the buffer pool; the entry goes with the last one
+		for (FrameId i = entry->head; i != NO_FRAME;)
+		{
+			const FrameId next = bufDescTable[i].fileNext;
+			freeFrame(i);
+			i = next;
+		}
+	}
+
+	/**
+	 * Removes all pages of the file from the buffer pool without writing them back.
+	 *
+	 * @param file   	File object
+	 * @throws  PagePinnedException If any page of the file is pinned in the buffer pool
+	 */
+	void BufMgr::dropFile(const File *file)
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		settleFile(lock, file);
+		FileFrames *entry = fileFrames(file->id());
+		for (FrameId i = entry == NULL ? NO_FRAME : entry->head; i != NO_FRAME;)
+		{
+			const FrameId next = bufDescTable[i].fileNext;
+			freeFrame(i);
+			i = next;
+		}
+	}
+
+	/**
+	 * Shrinks the file to its first numPages pages.  Frames holding pages past the new end are freed without being
+	 * written back, dirty or not, before the file is truncated.
+	 *
+	 * @param file   	File object
+	 * @param numPages	New number of pages of the file, header page included
+	 * @throws  PagePinnedException If any page past the new end is pinned in the buffer pool; nothing is removed
+	 * @throws  InvalidPageException If numPages is zero or larger than the file; nothing is removed
+	 */
+	void BufMgr::truncateFile(File *file, const PageId numPages)
+	{
+		std::unique_lock<std::mutex> lock(latch);
+		{
+			// Check first, so that a bad size discards nothing.
+			std::shared_lock<std::shared_mutex> fileGuard(fileLatch);
+			if (numPages == 0 || numPages > file->readHeader().num_pages)
+			{
+				throw InvalidPageException(numPages, file->filename());
 			}
 		}
+		settleFile(lock, file, numPages);
+		FileFrames *entry = fileFrames(file->id());
+		for (FrameId i = entry == NULL ? NO_FRAME : entry->head; i != NO_FRAME;)
+		{
+			const FrameId next = bufDescTable[i].fileNext;
+			if (bufDescTable[i].pageNo() >= numPages)
+			{
+				freeFrame(i);
+			}
+			i = next;
+		}
+		// Readers of the file hold fileLatch shared; none can be reading a page that is going away.
+		std::unique_lock<std::shared_mutex> fileGuard(fileLatch);
+		file->truncate(numPages);
 	}
 
 	/**
@@ -238,18 +1291,49 @@ namespace badgerdb
 	 */
 	void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page)
 	{
-		Page temp_page = file->allocatePage();
+		std::unique_lock<std::mutex> lock(latch);
 
+		// find a frame first so a full pool does not leave an orphaned page in the file
 		FrameId frame;
-		allocBuf(frame);
-		bufPool[frame] = temp_page;
+		allocBuf(lock, frame);
 
-		page = &bufPool[frame];
+		Page temp_page;
+		std::uint64_t linkVersion;
+		{
+			// rewrites the file's page lists, which page I/O running without the latch reads
+			std::unique_lock<std::shared_mutex> structure(fileLatch);
+			temp_page = file->allocatePage();
+			linkVersion = file->linkVersion();
+		}
+		bufStats.accesses++;
+		recordAccess(makePageKey(file->id(), temp_page.page_number()));
+		bufStats.diskreads++;
 		pageNo = temp_page.page_number();
 
+		// A reader may have looked up a deleted page just before it was reused here and be reading it in now.
+		// Its read either fails, or runs after allocatePage() and finds the new page; then share its frame.
+		FrameId resident;
+		bufDescTable[frame].io = BufDesc::IO_READ; // keeps the frame found above while waiting
+		while ((resident = findFrame(makePageKey(file->id(), pageNo))) != BufHashTbl::NOT_FOUND &&
+			   bufDescTable[resident].io != BufDesc::IO_NONE)
+		{
+			waitForIo(lock, resident);
+		}
+		finishIo(frame);
+		if (resident != BufHashTbl::NOT_FOUND)
+		{
+			bufDescTable[resident].refbit = true;
+			bufDescTable[resident].pinCnt++;
+			page = &bufPool[resident];
+			return;
+		}
+
+		bufPool[frame] = temp_page;
+		bufDescTable[frame].linkVersion = linkVersion;
+		page = &bufPool[frame];
+
 		// set and insert the page
-		bufDescTable[frame].Set(file, pageNo);
-		hashTable->insert(file, pageNo, frame);
+		assignFrame(frame, file, pageNo);
 	}
 
 	/**
@@ -261,32 +1345,35 @@ namespace badgerdb
 	 */
 	void BufMgr::disposePage(File *file, const PageId PageNo)
 	{
+		std::unique_lock<std::mutex> lock(latch);
+		// find the frame ID of the page to dispose, if available in buffer pool
 		FrameId frame;
-		try
+		while ((frame = findFrame(makePageKey(file->id(), PageNo))) != BufHashTbl::NOT_FOUND)
 		{
-			// find the frame ID of the page to dispose, if available in buffer pool
-			hashTable->lookup(file, PageNo, frame);
-
 			// check if the page is pinned
 			if (bufDescTable[frame].pinCnt > 0)
 			{
 				throw PagePinnedException(file->filename(), PageNo, frame);
 			}
+			if (bufDescTable[frame].io != BufDesc::IO_NONE)
+			{
+				// being written back; it is evicted afterwards
+				waitForIo(lock, frame);
+				continue;
+			}
 
-			// clear bufDescTable's frame of the page since it's getting disposed from the buffer pool
-			bufDescTable[frame].Clear();
-			// remove from hash table
-			hashTable->remove(file, PageNo);
-		}
-		catch (HashNotFoundException e)
-		{
+			// free the frame of the page since it's getting disposed from the buffer pool
+			freeFrame(frame);
+			break;
 		}
 
+		std::unique_lock<std::shared_mutex> structure(fileLatch);
 		file->deletePage(PageNo);
 	}
 
 	void BufMgr::printSelf(void)
 	{
+		std::lock_guard<std::mutex> guard(latch);
 		BufDesc *tmpbuf;
 		int validFrames = 0;
 
@@ -7,8 +7,20 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
 #include "file.h"
 #include "bufHashTbl.h"
+#include "frequency_sketch.h"
+#include "memory_budget.h"
 
 namespace badgerdb {
 
@@ -17,23 +29,61 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+* Frame number ending the per-file frame lists
+*/
+static const FrameId NO_FRAME = ~(FrameId)0;
+
+/**
+* @brief Frames of the buffer pool holding pages of one file: the head of a list threaded through the BufDesc
+* objects, found through a chained hash table on the file id
+*/
+struct FileFrames
+{
+	/**
+   * Id of the file
+	 */
+  FileId file;
+
+	/**
+   * First frame of the list
+	 */
+  FrameId head;
+
+	/**
+   * Number of frames in the list
+	 */
+  std::uint32_t count;
+
+	/**
+   * Next entry in the same hash chain
+	 */
+  FileFrames* next;
+};
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
 class BufDesc {
 
 	friend class BufMgr;
+	template <class T> friend class TrackedArray;
 
  private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+   * I/O a frame can be undergoing while the pool latch is released
 	 */
-  File* file;
+  enum IoState
+  {
+		IO_NONE,	// no I/O
+		IO_READ,	// the page is being read into the frame
+		IO_WRITE	// the page in the frame is being written back
+  };
 
 	/**
-   * Page within file to which corresponding frame is assigned
+   * Id of the file and page within the file to which corresponding frame is assigned
 	 */
-  PageId pageNo;
+  PageKey key;
 
 	/**
    * Frame number of the frame, in the buffer pool, being used
@@ -60,14 +110,47 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * True if the frame is in the admission window rather than the main region (only with admission enabled).
+   * Left alone by Clear(); BufMgr takes frames out of the window itself so it can keep count.
+	 */
+  bool inWindow;
+
+	/**
+   * True if the frame has an entry in the window queue, which may be stale
+	 */
+  bool queued;
+
+	/**
+   * True if the frame has an entry in the background writer's queue
+	 */
+  bool writeQueued;
+
+	/**
+   * I/O in progress on the frame.  While it is not IO_NONE the frame is neither pinned nor evicted, and threads
+   * wanting its page wait for the I/O to finish.  Left alone by Clear() and Set().
+	 */
+  IoState io;
+
+	/**
+   * Link version of the file (File::linkVersion()) taken before the page was read or allocated; while it is
+   * current the frame's next page pointer matches the one on disk, and writing the page back takes one I/O call.
+	 */
+  std::uint64_t linkVersion;
+
+	/**
+   * Previous and next frame holding a page of the same file, or NO_FRAME.  Maintained by BufMgr while the
+   * frame is valid.
+	 */
+  FrameId filePrev, fileNext;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
   void Clear()
 	{
     pinCnt = 0;
-		file = NULL;
-		pageNo = Page::INVALID_NUMBER;
+		key = makePageKey(0, Page::INVALID_NUMBER);
     dirty = false;
     refbit = false;
 		valid = false;
@@ -80,22 +163,39 @@ class BufDesc {
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
 	 */
-  void Set(File* filePtr, PageId pageNum)
+  void Set(const File* filePtr, PageId pageNum)
 	{ 
-		file = filePtr;
-    pageNo = pageNum;
+		key = makePageKey(filePtr->id(), pageNum);
     pinCnt = 1;
     dirty = false;
     valid = true;
     refbit = true;
   }
 
+	/**
+   * Id of the file the frame is assigned to
+	 */
+  FileId fileId() const { return pageKeyFile(key); }
+
+	/**
+   * Page within the file the frame is assigned to
+	 */
+  PageId pageNo() const { return pageKeyPage(key); }
+
+	/**
+   * Name of the file the frame is assigned to
+	 */
+  std::string filename() const
+	{
+		return FileRegistry::instance().name(fileId());
+	}
+
   void Print()
 	{
-		if(file)
+		if(valid)
 		{
-			std::cout << "file:" << file->filename() << " ";
-			std::cout << "pageNo:" << pageNo << " ";
+			std::cout << "file:" << filename() << " ";
+			std::cout << "pageNo:" << pageNo() << " ";
 		}
 		else
 			std::cout << "file:NULL ";
@@ -103,13 +203,15 @@ class BufDesc {
 		std::cout << "valid:" << valid << " ";
 		std::cout << "pinCnt:" << pinCnt << " ";
 		std::cout << "dirty:" << dirty << " ";
-		std::cout << "refbit:" << refbit << "\n";
+		std::cout << "refbit:" << refbit << " ";
+		std::cout << "io:" << io << "\n";
   }
 
 	/**
    * Constructor of BufDesc class 
 	 */
   BufDesc()
+		: inWindow(false), queued(false), writeQueued(false), io(IO_NONE), filePrev(NO_FRAME), fileNext(NO_FRAME)
 	{
   	Clear();
   }
@@ -136,12 +238,45 @@ struct BufStats
 	 */
   int diskwrites;
 
+	/**
+   * Number of pages the admission filter evicted from the window instead of letting them displace a page of the
+   * main region
+	 */
+  int rejections;
+
+	/**
+   * Number of dirty pages written back by the thread that needed their frame, while reading or allocating a page
+	 */
+  int syncWrites;
+
+	/**
+   * Number of dirty pages written back by the background writer
+	 */
+  int backgroundWrites;
+
+	/**
+   * Number of write-backs by the background writer that failed; the pages stay dirty
+	 */
+  int backgroundWriteErrors;
+
+	/**
+   * Number of times a thread found the page it wanted undergoing another thread's read or write-back and waited
+   * for it, rather than doing I/O of its own
+	 */
+  int ioWaits;
+
+	/**
+   * Number of victims taken from the frames a previous sweep of the clock collected, rather than found by a
+   * sweep of their own
+	 */
+  int cachedVictims;
+
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = diskreads = diskwrites = rejections = syncWrites = backgroundWrites = backgroundWriteErrors = ioWaits = cachedVictims = 0;
   }
       
 	/**
@@ -156,10 +291,70 @@ struct BufStats
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* All public methods may be called from multiple threads.  A pinned page stays in its frame until unpinned, but callers
+* sharing a page across threads must coordinate access to its contents themselves.
 */
 class BufMgr 
 {
+ public:
+	/**
+   * Callback reporting progress of the shutdown flush: pages written so far and pages to write in total.
+	 */
+  typedef std::function<void(std::uint64_t written, std::uint64_t total)> FlushProgress;
+
+	/**
+   * Number of I/O threads the destructor uses to write back dirty pages, unless changed with setFlushThreads().
+	 */
+  static const unsigned DEFAULT_FLUSH_THREADS = 4;
+
+	/**
+   * Percentage of the frames enableAdmission() gives the window unless told otherwise.
+	 */
+  static const unsigned DEFAULT_ADMISSION_WINDOW = 1;
+
+	/**
+   * Frames the clock looks past a dirty victim for a clean one before settling for the dirty one.
+	 */
+  static const std::uint32_t DIRTY_SKIP_LIMIT = 32;
+
+	/**
+   * Number of condition variables threads waiting for a frame's I/O are spread over, by frame number.
+	 */
+  static const std::uint32_t IO_WAIT_STRIPES = 64;
+
+	/**
+   * Victims a sweep of the clock collects unless changed with setEvictionBatch(), and the most it can be set to.
+	 */
+  static const std::uint32_t DEFAULT_EVICTION_BATCH = 16;
+  static const std::uint32_t MAX_EVICTION_BATCH = 64;
+
  private:
+	/**
+   * Budget created by the pool itself when the constructor isn't given one; it only tracks usage
+	 */
+  std::unique_ptr<MemoryBudget> ownBudget;
+
+	/**
+   * Budget all memory of the pool is reserved against
+	 */
+  MemoryBudget* budget;
+
+	/**
+   * The BufMgr object itself, including the statistics
+	 */
+  MemoryReservation selfReservation;
+
+	/**
+   * Memory of bufDescTable
+	 */
+  TrackedArray<BufDesc> descs;
+
+	/**
+   * Memory of bufPool
+	 */
+  TrackedArray<Page> frames;
+
 	/**
    * Current position of clockhand in our buffer pool
 	 */
@@ -171,32 +366,356 @@ class BufMgr
   std::uint32_t numBufs;
 	
 	/**
-   * Hash table mapping (File, page) to frame
+   * Hash table mapping (file id, page) to frame
 	 */
-  BufHashTbl *hashTable;
+  std::unique_ptr<BufHashTbl> hashTable;
 
 	/**
    * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
 	 */
   BufDesc *bufDescTable;
 
+	/**
+   * Hash chains of the files with pages in the pool, by file id
+	 */
+  TrackedArray<FileFrames*> fileChains;
+
+	/**
+   * Entries for fileChains; there are never more files in the pool than frames
+	 */
+  Arena<FileFrames> fileEntries;
+
 	/**
    * Maintains Buffer pool usage statistics 
 	 */
   BufStats bufStats;
 
+	/**
+   * Latch serializing all operations on the pool (descriptors, hash table, clock hand and statistics).
+   * Public methods acquire it; private helpers expect the caller to hold it.  Page reads and write-backs release
+   * it for the I/O itself, after marking the frame in BufDesc::io.
+	 */
+  std::mutex latch;
+
+	/**
+   * Orders page I/O done without the pool latch against allocating and deleting pages, which rewrite a file's
+   * page lists: the I/O holds it shared, allocPage() and disposePage() exclusively.  It may be acquired while
+   * holding the pool latch, never the other way round.
+	 */
+  std::shared_mutex fileLatch;
+
+	/**
+   * Signalled when the I/O of a frame finishes, striped by frame number
+	 */
+  std::condition_variable frameIoDone[IO_WAIT_STRIPES];
+
+	/**
+   * Number of reads and write-backs running with the latch released
+	 */
+  std::uint32_t ioInFlight;
+
+	/**
+   * Number of threads waiting in allocBuf() for an I/O to free a frame, and the condition they wait on
+	 */
+  std::uint32_t allocWaiters;
+  std::condition_variable allocWake;
+
+	/**
+   * Recent access frequencies of pages, if admission is enabled; NULL otherwise
+	 */
+  std::unique_ptr<FrequencySketch> sketch;
+
+	/**
+   * Frames of the admission window in the order they entered it, as a ring; entries of frames that have since
+   * left the window are skipped when they reach the front
+	 */
+  std::unique_ptr<TrackedArray<FrameId> > windowQueue;
+
+	/**
+   * Position of the oldest entry in windowQueue, and number of entries
+	 */
+  std::uint32_t windowHead, windowQueued;
+
+	/**
+   * Number of frames in the window, and the number it is kept to
+	 */
+  std::uint32_t windowCount, windowTarget;
+
+	/**
+   * Frames queued for the background writer, as a ring; NULL unless the writer is running
+	 */
+  std::unique_ptr<TrackedArray<FrameId> > writeQueue;
+
+	/**
+   * Position of the oldest entry in writeQueue, and number of entries
+	 */
+  std::uint32_t writeHead, writesQueued;
+
+	/**
+   * Set to make the background writer exit
+	 */
+  bool writerStop;
+
+	/**
+   * Signalled when a frame is queued for the background writer or it is to stop
+	 */
+  std::condition_variable writerWake;
+
+	/**
+   * The background writer thread, if running
+	 */
+  std::thread writer;
+
+	/**
+   * Clean victims collected by the last sweep of the clock, as a ring, in clock order
+	 */
+  FrameId victimCache[MAX_EVICTION_BATCH];
+
+	/**
+   * Position of the next victim in victimCache, and number of victims cached
+	 */
+  std::uint32_t victimHead, victimsCached;
+
+	/**
+   * Victims a sweep collects, including the one it returns
+	 */
+  std::uint32_t evictionBatch;
+
+	/**
+   * Number of I/O threads used by the shutdown flush
+	 */
+  unsigned flushThreads;
+
+	/**
+   * Called periodically during the shutdown flush, if set
+	 */
+  FlushProgress flushProgress;
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
   void advanceClock();
 
 	/**
-	 * Allocate a free frame.  
+	 * Write the dirty page in a frame back to its file, if some File object still has the file open.
+	 * Pages of files that have been closed are dropped: they must be flushed before the file is closed.
+	 * Takes fileLatch shared; the caller may or may not hold the pool latch, but must keep the frame from
+	 * changing meanwhile, and counts the write.
 	 *
+	 * @param frame   	Frame to write back
+	 * @return True if the page was written
+	 */
+  bool writeBack(FrameId frame);
+
+	/**
+	 * Write back the dirty page in a frame with the latch released.  The frame is marked IO_WRITE meanwhile, so
+	 * it is not evicted or pinned.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param frame   	Frame to write back
+	 * @return True if the page was written
+	 */
+  bool writeBackUnlatched(std::unique_lock<std::mutex>& lock, FrameId frame);
+
+	/**
+	 * Read pages into frames with the latch released.  The frames must already be set to the pages, pinned,
+	 * in the hash table and marked IO_READ.  If the read fails the frames are freed again.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param file   	File object
+	 * @param pageNos Page numbers to read
+	 * @param frameNos Frames to read them into, one per page
+	 * @param count   Number of pages
+	 */
+  void readFrames(std::unique_lock<std::mutex>& lock, File* file, const PageId pageNos[], const FrameId frameNos[],
+                  std::size_t count);
+
+	/**
+	 * Mark a frame's I/O finished and wake the threads waiting for it.
+	 */
+  void finishIo(FrameId frame);
+
+	/**
+	 * Wait until a frame has no I/O in progress.  The latch is released while waiting, so the frame may hold a
+	 * different page, or none, afterwards.
+	 */
+  void waitForIo(std::unique_lock<std::mutex>& lock, FrameId frame);
+
+	/**
+	 * Entry listing the frames of a file, or NULL if none of its pages are in the pool.
+	 */
+  FileFrames* fileFrames(const FileId file);
+
+	/**
+	 * Add a frame to the list of its file.
+	 */
+  void linkFrame(FrameId frame);
+
+	/**
+	 * Take a frame off the list of its file.
+	 */
+  void unlinkFrame(FrameId frame);
+
+	/**
+	 * Assign a frame to a page: set the descriptor up, pinned once, and enter the page in the hash table and in
+	 * the frame list of its file.
+	 */
+  void assignFrame(FrameId frame, File* file, const PageId pageNo);
+
+	/**
+	 * Free a valid frame: the opposite of assignFrame().  Nothing is written back.
+	 */
+  void freeFrame(FrameId frame);
+
+	/**
+	 * Wait for the I/O on every frame of a file that is undergoing any, then check that none are pinned.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param file   	File object
+	 * @param firstPage	Only pages numbered firstPage or higher are looked at
+	 * @throws PagePinnedException If any of those pages is pinned
+	 */
+  void settleFile(std::unique_lock<std::mutex>& lock, const File* file, const PageId firstPage = 0);
+
+	/**
+	 * Frame holding a page, or BufHashTbl::NOT_FOUND.
+	 */
+  FrameId findFrame(const PageKey key)
+  {
+		FrameId frame;
+		hashTable->lookupMany(&key, 1, &frame);
+		return frame;
+  }
+
+	/**
+	 * Pin a page, reading it in if it is not resident and waiting if another thread is reading or writing it.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return Frame holding the page
+	 */
+  FrameId fetchPage(std::unique_lock<std::mutex>& lock, File* file, const PageId pageNo);
+
+	/**
+	 * Evict the valid, unpinned page in a frame: write it back if dirty, remove it from the hash table and clear
+	 * the frame.  The latch is released while writing.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param frame   	Frame to evict
+	 * @return True if the latch was released
+	 */
+  bool evictFrame(std::unique_lock<std::mutex>& lock, FrameId frame);
+
+	/**
+	 * Queue a dirty frame for the background writer, if it is running.
+	 *
+	 * @param frame   	Frame to write back
+	 */
+  void queueWrite(FrameId frame);
+
+	/**
+	 * Body of the background writer: write back queued frames until told to stop.
+	 */
+  void runBackgroundWriter();
+
+	/**
+	 * Count an access to a page for the admission filter, if there is one.
+	 */
+  void recordAccess(const PageKey key)
+  {
+		if (sketch)
+			sketch->increment(key);
+  }
+
+	/**
+	 * Allocate a frame with admission enabled: the new page goes into the window, and when the window is full its
+	 * oldest page either moves to the main region, displacing the clock's victim there, or is evicted, whichever
+	 * the frequency sketch says has been used more.
+	 *
+	 * @param lock   	Lock on the pool latch
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param released Set if the latch was released
+	 * @return False if every frame is pinned or undergoing I/O
+	 */
+  bool allocBufAdmitted(std::unique_lock<std::mutex>& lock, FrameId & frame, bool & released);
+
+	/**
+	 * Find the clock's victim in the main region: an invalid frame, or an unpinned one not referenced recently.
+	 * Frames undergoing I/O count as pinned.  Victims cached by an earlier sweep are used first.
+	 *
+	 * @param frame   	Frame found
+	 * @return False if every frame of the main region is pinned
+	 */
+  bool findMainVictim(FrameId & frame);
+
+	/**
+	 * Collect the clean victims following the one the clock just found into victimCache.
+	 */
+  void harvestVictims();
+
+	/**
+	 * True if a frame can be taken for a new page without writing anything back: free, or holding a clean,
+	 * unpinned page of the main region that hasn't been referenced since the clock last passed.
+	 */
+  static bool isCleanVictim(const BufDesc& desc)
+  {
+		if (desc.io != BufDesc::IO_NONE)
+			return false;
+		return desc.valid == false ||
+			   (desc.inWindow == false && desc.pinCnt == 0 && desc.refbit == false && desc.dirty == false);
+  }
+
+	/**
+	 * Take the oldest unpinned frame without I/O in progress off the window queue.
+	 *
+	 * @param frame   	Frame found
+	 * @return False if the window has no unpinned frame
+	 */
+  bool popWindow(FrameId & frame);
+
+	/**
+	 * Put a frame into the window.
+	 */
+  void enterWindow(FrameId frame);
+
+	/**
+	 * Take a frame out of the window, if it is in it.
+	 */
+  void leaveWindow(FrameId frame)
+  {
+		if (bufDescTable[frame].inWindow)
+		{
+			bufDescTable[frame].inWindow = false;
+			windowCount--;
+		}
+  }
+
+	/**
+	 * Write back every dirty frame, as part of shutdown.  Frames are grouped by file and written in page order
+	 * within each file, in batches spread over flushThreads I/O threads.
+	 */
+  void flushAllDirty();
+
+	/**
+	 * Number of hash table chains for a pool of <bufs> frames.
+	 */
+  static int hashTableSize(const std::uint32_t bufs)
+  {
+		return ((((int)(bufs * 1.2)) * 2) / 2) + 1;
+  }
+
+	/**
+	 * Allocate a free frame.  If the victim is dirty the latch is released while it is written back, and if every
+	 * frame is pinned or undergoing I/O this waits for an I/O to finish; either way another thread may have read
+	 * the page the caller wants meanwhile, so the caller must look it up again if this returns true.
+	 *
+	 * @param lock   	Lock on the pool latch
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @return True if the latch was released
 	 * @throws BufferExceededException If no such buffer is found which can be allocated
 	 */
-  void allocBuf(FrameId & frame);
+  bool allocBuf(std::unique_lock<std::mutex>& lock, FrameId & frame);
 
  public:
 	/**
@@ -205,9 +724,37 @@ class BufMgr
   Page* bufPool;
 
 	/**
-   * Constructor of BufMgr class
+   * Constructor of BufMgr class.  All memory of the pool is allocated here and reserved against <sharedBudget>,
+   * or, if that is NULL, against an unlimited budget of the pool's own that only tracks it.
+	 *
+	 * @param bufs         Number of frames
+	 * @param sharedBudget Budget to reserve the pool's memory against, or NULL
+   * @throws MemoryBudgetExceededException If the budget can't cover the pool; nothing stays reserved
+	 */
+  BufMgr(std::uint32_t bufs, MemoryBudget* sharedBudget = NULL);
+
+	/**
+   * Bytes a pool of <bufs> frames reserves against its budget.
+	 */
+  static std::uint64_t bytesForFrames(std::uint32_t bufs);
+
+	/**
+   * Largest number of frames a pool can have within <bytes>.
+	 */
+  static std::uint32_t framesForBudget(std::uint64_t bytes);
+
+	/**
+   * Bytes this pool has reserved against its budget.
 	 */
-  BufMgr(std::uint32_t bufs);
+  std::uint64_t memoryUsage() const;
+
+	/**
+   * Budget the pool's memory is reserved against; with a shared budget, its usage includes other pools.
+	 */
+  const MemoryBudget& memoryBudget() const
+  {
+		return *budget;
+  }
 	
 	/**
    * Destructor of BufMgr class
@@ -217,7 +764,9 @@ class BufMgr
 	/**
 	 * Reads the given page from the file into a frame and returns the pointer to page.
 	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.  The read happens without
+	 * holding the pool latch; other threads asking for the same page meanwhile wait for it instead of reading it
+	 * again.
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number in the file to be read
@@ -225,6 +774,32 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Pins the given page and returns it if it is already in the buffer pool; never reads from disk or waits for
+	 * another thread's I/O on the page.  Lets callers that must not block (such as coroutines) take the fast path
+	 * and hand misses to readPage() on an I/O thread.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file
+	 * @param page  	Reference to page pointer, set to the frame holding the page if it is resident
+	 * @return True if the page was resident and is now pinned
+	 */
+  bool tryReadPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Reads many pages of a file at once, as for a list of record ids or the probes of an index lookup, and
+	 * returns them pinned.  The pages are looked up together with BufHashTbl::lookupMany(), and those not in
+	 * the buffer pool are read with File::readPages(), one vectored read per run of adjacent pages.  A page
+	 * listed twice is pinned twice.  If any page can't be pinned or read, none stays pinned.
+	 *
+	 * @param file   	File object
+	 * @param pageNos Page numbers in the file to be read
+	 * @param pages  	Array of page pointers, pages[i] set to the frame holding pageNos[i]
+	 * @throws BufferExceededException If the pool runs out of frames to read the missing pages into
+	 * @throws InvalidPageException If any of the pages does not exist in the file
+	 */
+  void readPages(File* file, const std::vector<PageId>& pageNos, Page* pages[]);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -246,9 +821,10 @@ class BufMgr
   void allocPage(File* file, PageId &PageNo, Page*& page); 
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
+	 * Writes out all dirty pages of the file to disk and removes its pages from the buffer pool.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
+	 * Otherwise Error returned, and no page is written or removed.  Takes time proportional to the number of pages of
+	 * the file in the pool, not the size of the pool.
 	 *
 	 * @param file   	File object
    * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
@@ -256,6 +832,27 @@ class BufMgr
 	 */
   void flushFile(const File* file);
 
+	/**
+	 * Removes all pages of the file from the buffer pool without writing any back, dirty or not; for a file that is
+	 * about to be deleted or whose contents no longer matter.  Takes time proportional to the number of pages of the
+	 * file in the pool.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool; nothing is removed
+	 */
+  void dropFile(const File* file);
+
+	/**
+	 * Shrinks the file to its first numPages pages (see File::truncate()), first removing the pages past the new end
+	 * from the buffer pool without writing any back, dirty or not.
+	 *
+	 * @param file   	File object
+	 * @param numPages	New number of pages of the file, header page included
+   * @throws  PagePinnedException If any page past the new end is pinned in the buffer pool; nothing is removed
+   * @throws  InvalidPageException If numPages is zero or larger than the file; nothing is removed
+	 */
+  void truncateFile(File* file, const PageId numPages);
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
@@ -265,6 +862,62 @@ class BufMgr
 	 */
   void disposePage(File* file, const PageId PageNo);
 
+	/**
+   * Set the number of I/O threads the destructor uses to write back dirty pages.  One writes them on the calling thread.
+	 *
+	 * @param threads	Number of threads
+	 */
+  void setFlushThreads(unsigned threads)
+  {
+		std::lock_guard<std::mutex> guard(latch);
+		flushThreads = threads > 0 ? threads : 1;
+  }
+
+	/**
+   * Set a callback the destructor calls about twice a second, and once at the end, while writing back dirty pages.
+	 *
+	 * @param progress	Callback, or an empty function for none
+	 */
+  void setFlushProgress(FlushProgress progress)
+  {
+		std::lock_guard<std::mutex> guard(latch);
+		flushProgress = progress;
+  }
+
+	/**
+   * Turn on TinyLFU admission.  A window of <windowPercent> percent of the frames (at least one) takes newly read
+   * pages; a page leaving the full window enters the main region only if a count-min sketch of recent accesses
+   * says it is used more than the page the clock would evict there, so pages touched once by a scan don't push
+   * out pages in regular use.  Rejected pages are counted in BufStats::rejections.  The sketch and the window
+   * queue are reserved against the pool's budget here.  Off unless this is called; it can't be turned off again.
+	 *
+	 * @param windowPercent	Size of the window as a percentage of the frames
+   * @throws MemoryBudgetExceededException If the budget can't cover the sketch
+	 */
+  void enableAdmission(unsigned windowPercent = DEFAULT_ADMISSION_WINDOW);
+
+	/**
+   * Set how many victims one sweep of the clock collects.  A miss sweeps on past its victim and caches the next
+   * clean ones it finds, so the misses that follow take a frame from the cache rather than each running the
+   * clock again (counted in BufStats::cachedVictims).  One turns this off.
+	 *
+	 * @param frames	Victims per sweep, at most MAX_EVICTION_BATCH
+	 */
+  void setEvictionBatch(unsigned frames);
+
+	/**
+   * Start a background writer thread.  Dirty pages the clock passes over while looking for a clean victim are
+   * queued for it, so that by the time the clock comes round again they are clean and can be evicted without
+   * making a reader wait for a write.  Without it dirty victims are still passed over when a clean one is near,
+   * but are written by whichever thread finally evicts them (counted in BufStats::syncWrites).
+	 */
+  void startBackgroundWriter();
+
+	/**
+   * Stop the background writer, if running.  The destructor does this before writing back dirty pages.
+	 */
+  void stopBackgroundWriter();
+
 	/**
    * Print member variable values. 
 	 */
@@ -283,6 +936,7 @@ class BufMgr
 	 */
   void clearBufStats() 
   {
+		std::lock_guard<std::mutex> guard(latch);
 		bufStats.clear();
   }
 };
@@ -0,0 +1,123 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * @file
+ * @brief Benchmarks of coroutine page access against blocking threads.
+ *
+ * Both read random pages of a file twice the size of the pool, so about half
+ * of the lookups miss.  The coroutine runs keep thousands of lookups in
+ * flight on one or two worker threads; the blocking runs need a thread per
+ * lookup in flight.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench/benchmark.h"
+#include "bench/bench_util.h"
+#include "buffer.h"
+#include "coro/page_fetch.h"
+#include "coro/scheduler.h"
+#include "coro/task.h"
+
+namespace badgerdb {
+namespace bench {
+
+namespace {
+
+const PageId FILE_PAGES = 4096;
+const std::uint32_t POOL_FRAMES = 2048;
+const int LOOKUPS_PER_TASK = 16;
+
+coro::Task<> lookups(BufMgr& pool, File* file,
+                     const std::vector<PageId>& pages, const unsigned seed,
+                     std::atomic<bool>& failed) {
+  std::mt19937 rng(seed);
+  for (int i = 0; i < LOOKUPS_PER_TASK; ++i) {
+    const PageId page_no = pages[rng() % pages.size()];
+    coro::PageGuard page = co_await coro::fetch(pool, file, page_no);
+    if (page->page_number() != page_no) {
+      failed = true;
+    }
+  }
+}
+
+}
+
+/**
+ * range(0) coroutines doing LOOKUPS_PER_TASK lookups each, on range(1)
+ * worker threads and four I/O threads.  Items are lookups.
+ */
+static void BM_CoroFetch(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("coro", FILE_PAGES);
+  BufMgr pool(POOL_FRAMES);
+  coro::Scheduler scheduler(state.range(1));
+  std::atomic<bool> failed(false);
+  unsigned seed = 0;
+  while (state.KeepRunning()) {
+    for (std::int64_t t = 0; t < state.range(0); ++t) {
+      scheduler.spawn(lookups(pool, scratch.file(), scratch.pageNumbers(),
+                              seed++, failed));
+    }
+    scheduler.run();
+  }
+  if (failed) {
+    state.SkipWithError("fetched the wrong page");
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          LOOKUPS_PER_TASK);
+}
+BENCHMARK(BM_CoroFetch)->Args({1000, 1})->Args({1000, 2})
+    ->Args({4000, 2});
+
+/**
+ * The same lookups on range(0) threads calling BufMgr::readPage.  Each
+ * iteration is LOOKUPS_PER_TASK lookups per thread.
+ */
+static void BM_BlockingFetch(State& state) {
+  ScratchFile& scratch = ScratchFile::shared("coro", FILE_PAGES);
+  BufMgr pool(POOL_FRAMES);
+  const std::vector<PageId>& pages = scratch.pageNumbers();
+  File* file = scratch.file();
+  std::atomic<bool> failed(false);
+  unsigned seed = 0;
+  while (state.KeepRunning()) {
+    std::vector<std::thread> threads;
+    for (std::int64_t t = 0; t < state.range(0); ++t) {
+      threads.push_back(std::thread([&pool, &pages, file, &failed](
+                                        const unsigned thread_seed) {
+        std::mt19937 rng(thread_seed);
+        for (int i = 0; i < LOOKUPS_PER_TASK; ++i) {
+          const PageId page_no = pages[rng() % pages.size()];
+          Page* page;
+          pool.readPage(file, page_no, page);
+          if (page->page_number() != page_no) {
+            failed = true;
+          }
+          pool.unPinPage(file, page_no, false);
+        }
+      }, seed++));
+    }
+    for (std::size_t t = 0; t < threads.size(); ++t) {
+      threads[t].join();
+    }
+  }
+  if (failed) {
+    state.SkipWithError("fetched the wrong page");
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          LOOKUPS_PER_TASK);
+}
+BENCHMARK(BM_BlockingFetch)->Arg(2)->Arg(8);
+
+}
+}
@@ -0,0 +1,179 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <thread>
+#include <utility>
+
+#include "buffer.h"
+#include "coro/scheduler.h"
+#include "exceptions/buffer_exceeded_exception.h"
+
+namespace badgerdb {
+namespace coro {
+
+/**
+ * @brief A pinned page that is unpinned when the guard goes away.
+ */
+class PageGuard {
+ public:
+  PageGuard()
+      : mgr_(NULL), file_(NULL), page_no_(Page::INVALID_NUMBER), page_(NULL),
+        dirty_(false) {}
+
+  /**
+   * Takes over a pin on <page>.
+   */
+  PageGuard(BufMgr* mgr, File* file, const PageId page_no, Page* page)
+      : mgr_(mgr), file_(file), page_no_(page_no), page_(page),
+        dirty_(false) {}
+
+  PageGuard(PageGuard&& other) noexcept
+      : mgr_(other.mgr_), file_(other.file_), page_no_(other.page_no_),
+        page_(std::exchange(other.page_, nullptr)), dirty_(other.dirty_) {}
+
+  PageGuard& operator=(PageGuard&& other) noexcept {
+    if (this != &other) {
+      release();
+      mgr_ = other.mgr_;
+      file_ = other.file_;
+      page_no_ = other.page_no_;
+      page_ = std::exchange(other.page_, nullptr);
+      dirty_ = other.dirty_;
+    }
+    return *this;
+  }
+
+  PageGuard(const PageGuard&) = delete;
+  PageGuard& operator=(const PageGuard&) = delete;
+
+  ~PageGuard() { release(); }
+
+  Page* get() const { return page_; }
+  Page* operator->() const { return page_; }
+  Page& operator*() const { return *page_; }
+  explicit operator bool() const { return page_ != NULL; }
+
+  /**
+   * Makes the unpin mark the page dirty.
+   */
+  void markDirty() { dirty_ = true; }
+
+  /**
+   * Unpins the page now.
+   */
+  void release() {
+    if (page_ != NULL) {
+      page_ = NULL;
+      mgr_->unPinPage(file_, page_no_, dirty_);
+    }
+  }
+
+ private:
+  BufMgr* mgr_;
+  File* file_;
+  PageId page_no_;
+  Page* page_;
+  bool dirty_;
+};
+
+/**
+ * @brief Awaitable returned by fetch().
+ */
+class FetchAwaiter {
+ public:
+  FetchAwaiter(BufMgr& mgr, File* file, const PageId page_no)
+      : mgr_(mgr), file_(file), page_no_(page_no), page_(NULL) {}
+
+  /**
+   * Hits complete without suspending.
+   */
+  bool await_ready() { return mgr_.tryReadPage(file_, page_no_, page_); }
+
+  /**
+   * On a miss, submits the read to the scheduler's I/O pool and suspends
+   * until it is done.  Off a scheduler thread the read is done inline.
+   */
+  bool await_suspend(std::coroutine_handle<> awaiter) {
+    Scheduler* const scheduler = Scheduler::current();
+    if (scheduler == NULL) {
+      try {
+        mgr_.readPage(file_, page_no_, page_);
+      } catch (...) {
+        error_ = std::current_exception();
+      }
+      return false;
+    }
+    scheduler->io().submit([this, scheduler, awaiter]() {
+      read(scheduler, awaiter);
+    });
+    return true;
+  }
+
+  PageGuard await_resume() {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return PageGuard(&mgr_, file_, page_no_, page_);
+  }
+
+ private:
+  /**
+   * Reads the page on an I/O thread and queues the awaiting coroutine.
+   */
+  void read(Scheduler* scheduler, std::coroutine_handle<> awaiter) {
+    try {
+      mgr_.readPage(file_, page_no_, page_);
+    } catch (const BufferExceededException&) {
+      if (scheduler->busy()) {
+        // Every frame is pinned, typically by coroutines whose reads finished
+        // and that are waiting for a worker thread.  Try again once they had
+        // a chance to run and unpin.
+        std::this_thread::yield();
+        scheduler->io().submit([this, scheduler, awaiter]() {
+          read(scheduler, awaiter);
+        });
+        return;
+      }
+      error_ = std::current_exception();
+    } catch (...) {
+      error_ = std::current_exception();
+    }
+    scheduler->post(awaiter);
+  }
+
+  BufMgr& mgr_;
+  File* const file_;
+  const PageId page_no_;
+  Page* page_;
+  std::exception_ptr error_;
+};
+
+/**
+ * Pins a page of <file> in <mgr>, for use in a coroutine:
+ *
+ * @code
+ *   coro::Task<> lookup(BufMgr& pool, File* file, PageId page_no) {
+ *     coro::PageGuard page = co_await coro::fetch(pool, file, page_no);
+ *     use(page->getRecord(rid));
+ *   }  // unpinned here
+ * @endcode
+ *
+ * A resident page is returned at once; otherwise the coroutine suspends
+ * while an I/O thread reads the page, and resumes on a worker thread.
+ *
+ * @throws  Whatever BufMgr::readPage throws, when the result is awaited.
+ */
+inline FetchAwaiter fetch(BufMgr& mgr, File* file, const PageId page_no) {
+  return FetchAwaiter(mgr, file, page_no);
+}
+
+}
+}
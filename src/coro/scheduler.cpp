@@ -0,0 +1,131 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "coro/scheduler.h"
+
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+namespace coro {
+
+namespace {
+
+thread_local Scheduler* current_scheduler = NULL;
+
+}
+
+/**
+ * @brief Coroutine that owns a top-level task; it starts suspended and frees
+ *        itself when done.
+ */
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() {
+      return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  static Detached wrap(Scheduler* scheduler, Task<void> task) {
+    std::exception_ptr error;
+    try {
+      co_await task;
+    } catch (...) {
+      error = std::current_exception();
+    }
+    scheduler->finished(error);
+  }
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+Scheduler::Scheduler(const unsigned threads, const unsigned io_threads)
+    : threads_(threads > 0 ? threads : 1), running_(0), live_(0),
+      io_(io_threads) {
+}
+
+void Scheduler::spawn(Task<void> task) {
+  const Detached root = Detached::wrap(this, std::move(task));
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    ++live_;
+  }
+  post(root.handle);
+}
+
+void Scheduler::post(std::coroutine_handle<> handle) {
+  std::lock_guard<std::mutex> guard(latch_);
+  ready_.push_back(handle);
+  ready_cv_.notify_one();
+}
+
+void Scheduler::finished(std::exception_ptr error) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (error && !error_) {
+    error_ = error;
+  }
+  if (--live_ == 0) {
+    // Notified under the latch: run() may return, and the scheduler be
+    // destroyed, as soon as the latch is released.
+    ready_cv_.notify_all();
+  }
+}
+
+bool Scheduler::busy() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return !ready_.empty() || running_ > 0;
+}
+
+Scheduler* Scheduler::current() {
+  return current_scheduler;
+}
+
+void Scheduler::run() {
+  std::vector<std::thread> helpers;
+  for (unsigned i = 1; i < threads_; ++i) {
+    helpers.push_back(std::thread(&Scheduler::work, this));
+  }
+  work();
+  for (std::size_t i = 0; i < helpers.size(); ++i) {
+    helpers[i].join();
+  }
+
+  std::lock_guard<std::mutex> guard(latch_);
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = NULL;
+    std::rethrow_exception(error);
+  }
+}
+
+void Scheduler::work() {
+  Scheduler* const previous = current_scheduler;
+  current_scheduler = this;
+  std::unique_lock<std::mutex> lock(latch_);
+  for (;;) {
+    ready_cv_.wait(lock, [this]() { return !ready_.empty() || live_ == 0; });
+    if (ready_.empty()) {
+      break;
+    }
+    const std::coroutine_handle<> next = ready_.front();
+    ready_.pop_front();
+    ++running_;
+    lock.unlock();
+    next.resume();
+    lock.lock();
+    --running_;
+  }
+  lock.unlock();
+  current_scheduler = previous;
+}
+
+}
+}
@@ -0,0 +1,140 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+#include "coro/task.h"
+#include "io_executor.h"
+
+namespace badgerdb {
+namespace coro {
+
+/**
+ * @brief Runs coroutines on a few worker threads, with blocking I/O moved to
+ *        a separate pool.
+ *
+ * Coroutines that must wait for the disk (see fetch()) hand the read to the
+ * scheduler's IoExecutor and are queued again once it is done, so worker
+ * threads only ever run coroutines that can make progress.
+ *
+ * @code
+ *   coro::Scheduler scheduler(2);
+ *   for (int i = 0; i < 1000; ++i) scheduler.spawn(lookup(pool, &file, i));
+ *   scheduler.run();
+ * @endcode
+ */
+class Scheduler {
+ public:
+  /**
+   * Constructs a scheduler.  No threads run until run() is called, except
+   * those of the I/O pool.
+   *
+   * @param threads     Worker threads run() uses, including the caller.
+   * @param io_threads  Threads that perform blocking reads.
+   */
+  explicit Scheduler(const unsigned threads = 1,
+                     const unsigned io_threads = 4);
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  /**
+   * Queues a top-level task.  May be called before run() or from a running
+   * coroutine.
+   *
+   * @param task  Task to run to completion.
+   */
+  void spawn(Task<void> task);
+
+  /**
+   * Runs coroutines on the calling thread and threads - 1 more until every
+   * spawned task has finished.
+   *
+   * @throws  Whatever the first failing top-level task threw.
+   */
+  void run();
+
+  /**
+   * Queues a suspended coroutine to be resumed by a worker thread.
+   * Threadsafe.
+   *
+   * @param handle  Coroutine to resume.
+   */
+  void post(std::coroutine_handle<> handle);
+
+  /**
+   * Returns true if coroutines are queued or running, i.e. some may still
+   * release resources such as pinned pages.
+   */
+  bool busy();
+
+  /**
+   * Returns the pool blocking reads are submitted to.
+   */
+  IoExecutor& io() { return io_; }
+
+  /**
+   * Returns the scheduler running the calling thread's coroutine, or NULL if
+   * the thread is not a worker thread.
+   */
+  static Scheduler* current();
+
+ private:
+  /**
+   * Body of each worker thread.
+   */
+  void work();
+
+  /**
+   * Called by the wrapper of a top-level task when it finishes.
+   */
+  void finished(std::exception_ptr error);
+
+  const unsigned threads_;
+
+  std::mutex latch_;
+
+  /**
+   * Signalled when a coroutine is queued or the last task finishes.
+   */
+  std::condition_variable ready_cv_;
+
+  std::deque<std::coroutine_handle<> > ready_;
+
+  /**
+   * Worker threads currently resuming a coroutine.
+   */
+  unsigned running_;
+
+  /**
+   * Top-level tasks spawned and not yet finished.
+   */
+  std::size_t live_;
+
+  /**
+   * First exception thrown by a top-level task since run() started.
+   */
+  std::exception_ptr error_;
+
+  /**
+   * Declared last so that it is destroyed first: its threads may still be
+   * returning from a post() when the last task finishes.
+   */
+  IoExecutor io_;
+
+  friend struct Detached;
+};
+
+}
+}
@@ -0,0 +1,30 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "address_space_exception.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+AddressSpaceException::AddressSpaceException(const std::uint64_t bytes,
+                                             const int error)
+    : BadgerDbException(""), bytes_(bytes) {
+  std::stringstream ss;
+  ss << "Could not reserve " << bytes << " bytes of address space: "
+     << std::strerror(error) << ".";
+  if (error == ENOMEM) {
+    // Strict overcommit charges the whole range, MAP_NORESERVE or not.
+    ss << "  Under vm.overcommit_memory=2 ask for fewer pages.";
+  }
+  message_.assign(ss.str());
+}
+
+}
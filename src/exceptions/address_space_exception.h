@@ -0,0 +1,43 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system refuses to
+ *        reserve a range of virtual memory.
+ */
+class AddressSpaceException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an address space exception.
+   *
+   * @param bytes   Size of the range asked for.
+   * @param error   errno value mmap() failed with.
+   */
+  AddressSpaceException(const std::uint64_t bytes, const int error);
+
+  /**
+   * Returns the size of the range that could not be reserved.
+   */
+  virtual std::uint64_t bytes() const { return bytes_; }
+
+ protected:
+  /**
+   * Size of the range that could not be reserved.
+   */
+  const std::uint64_t bytes_;
+};
+
+}
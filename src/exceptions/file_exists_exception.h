@@ -35,7 +35,7 @@ class FileExistsException : public BadgerDbException {
   /**
    * Name of file that caused this exception.
    */
-  const std::string& filename_;
+  const std::string filename_;
 };
 
 }
@@ -0,0 +1,25 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "memory_budget_exceeded_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+MemoryBudgetExceededException::MemoryBudgetExceededException(
+    const std::uint64_t requested, const std::uint64_t used,
+    const std::uint64_t limit)
+    : BadgerDbException("") {
+  std::stringstream ss;
+  ss << "Memory budget exceeded: " << requested << " bytes requested with "
+     << used << " of " << limit << " bytes in use.";
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,35 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when an allocation would take a
+ *        MemoryBudget over its limit.
+ */
+class MemoryBudgetExceededException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a memory budget exceeded exception.
+   *
+   * @param requested Bytes asked for.
+   * @param used      Bytes already in use.
+   * @param limit     Limit of the budget.
+   */
+  MemoryBudgetExceededException(const std::uint64_t requested,
+                                const std::uint64_t used,
+                                const std::uint64_t limit);
+};
+
+}
@@ -0,0 +1,42 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a tablespace is malformed or a
+ *        request does not fit in it (directory full, name too long, ...).
+ */
+class TablespaceException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a tablespace exception for the given tablespace.
+   *
+   * @param path    Path of the tablespace file.
+   * @param reason  What went wrong.
+   */
+  TablespaceException(const std::string& path, const std::string& reason);
+
+  /**
+   * Returns the path of the tablespace that caused this exception.
+   */
+  virtual const std::string& path() const { return path_; }
+
+ protected:
+  /**
+   * Path of the tablespace that caused this exception.
+   */
+  const std::string path_;
+};
+
+}
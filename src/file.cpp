@@ -7,97 +7,195 @@
 
 #include "file.h"
 
-#include <fstream>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <cstring>
 
-#include "exceptions/file_exists_exception.h"
-#include "exceptions/file_not_found_exception.h"
+#include "exceptions/file_format_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
+#include "io_executor.h"
 #include "page.h"
+#include "segmented_storage.h"
+#include "trace.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+namespace {
+
+const char FILE_MAGIC[8] = {'B', 'D', 'B', 'F', 'I', 'L', 'E', '\0'};
+
+/**
+ * Header of a format version 1 file.
+ */
+struct LegacyFileHeader {
+  PageId num_pages;
+  PageId first_used_page;
+  PageId num_free_pages;
+  PageId first_free_page;
+};
+
+static_assert(sizeof(LegacyFileHeader) == 16,
+              "Version 1 header is four 32-bit page numbers.");
+
+/**
+ * Start of a free-list trunk page in a file with FLAG_PUNCH_HOLES.  Trunks are
+ * free pages chained through the next page pointer of their page header; each
+ * is followed by the numbers of <count> further free pages, whose space has
+ * been punched out whole.
+ */
+struct TrunkHeader {
+  PageHeader header;
+  std::uint32_t count;
+};
+
+/**
+ * Number of free pages a trunk lists.
+ */
+const std::uint32_t TRUNK_CAPACITY =
+    (Page::SIZE - sizeof(TrunkHeader)) / sizeof(PageId);
+
+/**
+ * Returns the header of a new, empty file.
+ */
+FileHeader newHeader() {
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+  header.version = FileHeader::CURRENT_VERSION;
+  header.page_size = Page::SIZE;
+  // File starts with 1 page (the header).
+  header.num_pages = 1;
+  return header;
+}
+
+}
 
 File File::create(const std::string& filename) {
   return File(filename, true /* create_new */);
 }
 
+File File::createSegmented(const std::string& filename,
+                           const SegmentLayout& layout) {
+  File file(FileRegistry::instance().acquire(
+      filename, true,
+      [&layout](const std::string& name, const bool /* create_new */) {
+        return SegmentedStorage::create(name, layout);
+      }));
+  file.writeNewHeader();
+  return file;
+}
+
 File File::open(const std::string& filename) {
-  return File(filename, false /* create_new */);
+  File file(filename, false /* create_new */);
+  file.checkFormat();
+  return file;
 }
 
-void File::remove(const std::string& filename) {
-  if (!exists(filename)) {
-    throw FileNotFoundException(filename);
+bool File::upgrade(const std::string& filename) {
+  File file(filename, false /* create_new */);
+  if (file.entry_->refs.load(std::memory_order_acquire) > 1) {
+    throw FileOpenException(file.filename());
   }
-  if (isOpen(filename)) {
-    throw FileOpenException(filename);
+  FileHeader header;
+  file.readAt(&header, sizeof(header), 0 /* offset */);
+  if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0) {
+    file.checkFormat();
+    return false;
   }
-  std::remove(filename.c_str());
+
+  // Version 1: four page numbers, then page n at 16 + (n - 1) * Page::SIZE.
+  LegacyFileHeader legacy;
+  std::memcpy(&legacy, &header, sizeof(legacy));
+  if (legacy.num_pages == 0 || legacy.first_used_page >= legacy.num_pages ||
+      legacy.first_free_page >= legacy.num_pages ||
+      legacy.num_free_pages >= legacy.num_pages) {
+    throw FileFormatException(file.filename(), "not a BadgerDB file");
+  }
+
+  // Every page moves towards the end of the file, so moving the last one
+  // first never overwrites a page that is still to be moved.
+  Page page;
+  for (PageId n = legacy.num_pages - 1; n >= 1; --n) {
+    file.readAt(&page, Page::SIZE,
+                sizeof(LegacyFileHeader) +
+                    (static_cast<off_t>(n) - 1) * Page::SIZE);
+    file.writeAt(&page, Page::SIZE, pagePosition(n));
+  }
+
+  std::vector<char> header_page(Page::SIZE, 0);
+  file.writeAt(&header_page[0], Page::SIZE, 0 /* offset */);
+  FileHeader upgraded = newHeader();
+  upgraded.num_pages = legacy.num_pages;
+  upgraded.first_used_page = legacy.first_used_page;
+  upgraded.num_free_pages = legacy.num_free_pages;
+  upgraded.first_free_page = legacy.first_free_page;
+  file.writeHeader(upgraded);
+  return true;
+}
+
+void File::remove(const std::string& filename) {
+  FileRegistry::instance().remove(filename);
 }
 
 bool File::isOpen(const std::string& filename) {
-  if (!exists(filename)) {
-    return false;
-  }
-  return open_counts_.find(filename) != open_counts_.end();
+  // An open file is held by the registry; no need to touch the filesystem.
+  return FileRegistry::instance().isOpen(filename);
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+  struct stat st;
+  return ::stat(filename.c_str(), &st) == 0;
 }
 
-File::File(const File& other)
-  : filename_(other.filename_),
-    stream_(open_streams_[filename_]) {
-  ++open_counts_[filename_];
+File::File(const File& other) : entry_(other.entry_) {
+  FileRegistry::addRef(entry_);
 }
 
 File& File::operator=(const File& rhs) {
-  // This accounts for self-assignment and assignment of a File object for the
-  // same file.
-  close();	//close my file and associate me with the new one
-  filename_ = rhs.filename_;
-  openIfNeeded(false /* create_new */);
+  // Take the new reference first; this accounts for self-assignment and
+  // assignment of a File object for the same file.
+  FileRegistry::addRef(rhs.entry_);
+  FileRegistry::instance().release(entry_);
+  entry_ = rhs.entry_;
   return *this;
 }
 
 File::~File() {
-  close();
+  FileRegistry::instance().release(entry_);
 }
 
 Page File::allocatePage() {
+  relink();
   FileHeader header = readHeader();
   Page new_page;
   Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-    header.first_free_page = new_page.next_page_number();
+    if (header.flags & FileHeader::FLAG_PUNCH_HOLES) {
+      // Punched pages read as zero; the new page is written whole below.
+      new_page.set_page_number(popTrunkFree(header));
+    } else {
+      new_page = readPage(header.first_free_page, true /* allow_free */);
+      new_page.set_page_number(header.first_free_page);
+      header.first_free_page = new_page.next_page_number();
+    }
     --header.num_free_pages;
 
     if (header.first_used_page == Page::INVALID_NUMBER ||
         header.first_used_page > new_page.page_number()) {
       // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
+      // than the one we just allocated, so add the new page to the head.  The
+      // page's next pointer still links into the free list, so it has to be
+      // overwritten even when the used list is empty.
+      new_page.set_next_page_number(header.first_used_page);
       header.first_used_page = new_page.page_number();
     } else {
       // New page is reused from somewhere after the beginning, so we need to
@@ -123,11 +221,19 @@ Page File::allocatePage() {
       header.first_used_page = new_page.page_number();
     } else {
       // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
+      // of the linked list.  The used list is kept in page number order, so
+      // if the last page of the file is in use it is the tail and the walk
+      // can be skipped.
+      const PageId last_page_number = header.num_pages - 1;
+      if (readPageHeader(last_page_number).current_page_number ==
+          last_page_number) {
+        existing_page = readPage(last_page_number, false /* allow_free */);
+      } else {
+        for (FileIterator iter = begin(); iter != end(); ++iter) {
+          if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
+            existing_page = *iter;
+            break;
+          }
         }
       }
       assert(existing_page.isUsed());
@@ -149,28 +255,103 @@ Page File::allocatePage() {
 Page File::readPage(const PageId page_number) const {
   FileHeader header = readHeader();
   if (page_number >= header.num_pages) {
-    throw InvalidPageException(page_number, filename_);
+    throw InvalidPageException(page_number, filename());
   }
   return readPage(page_number, false /* allow_free */);
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
-  if (!allow_free && !page.isUsed()) {
-    throw InvalidPageException(page_number, filename_);
+  Page* const pages[1] = {&page};
+  readRun(page_number, 1, pages, allow_free);
+  return page;
+}
+
+void File::readPages(const PageId first, const std::size_t count,
+                     Page* const pages[]) const {
+  if (count == 0) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  if (first == Page::INVALID_NUMBER) {
+    throw InvalidPageException(first, filename());
   }
+  if (first + count > header.num_pages) {
+    throw InvalidPageException(
+        std::max<PageId>(first, header.num_pages), filename());
+  }
+  readRun(first, count, pages, false /* allow_free */);
+}
 
-  return page;
+void File::readPages(const std::vector<PageId>& page_numbers,
+                     Page* const pages[], IoExecutor* io) const {
+  const FileHeader header = readHeader();
+  std::vector<std::size_t> order(page_numbers.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    if (page_numbers[i] == Page::INVALID_NUMBER ||
+        page_numbers[i] >= header.num_pages) {
+      throw InvalidPageException(page_numbers[i], filename());
+    }
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(),
+            [&page_numbers](const std::size_t a, const std::size_t b) {
+              return page_numbers[a] < page_numbers[b];
+            });
+
+  // Destinations in page order, so that each run is a contiguous slice.
+  std::vector<Page*> sorted(order.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    sorted[i] = pages[order[i]];
+  }
+  std::size_t start = 0;
+  while (start < order.size()) {
+    std::size_t end = start + 1;
+    while (end < order.size() &&
+           page_numbers[order[end]] == page_numbers[order[end - 1]] + 1) {
+      ++end;
+    }
+    const PageId first = page_numbers[order[start]];
+    Page* const* run = &sorted[start];
+    const std::size_t count = end - start;
+    if (io != NULL) {
+      io->submit([this, first, count, run]() {
+        readRun(first, count, run, false /* allow_free */);
+      });
+    } else {
+      readRun(first, count, run, false /* allow_free */);
+    }
+    start = end;
+  }
+  if (io != NULL) {
+    io->wait();
+  }
+}
+
+void File::readRun(const PageId first, const std::size_t count,
+                   Page* const pages[], const bool allow_free) const {
+  // A Page object is the page as it is on disk, so each page is one buffer.
+  std::vector<struct iovec> iov(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    BADGERDB_TRACE2(file__read__start, filename().c_str(), first + i);
+    iov[i].iov_base = pages[i];
+    iov[i].iov_len = Page::SIZE;
+  }
+  entry_->storage->readv(&iov[0], static_cast<int>(iov.size()),
+                         pagePosition(first));
+  for (std::size_t i = 0; i < count; ++i) {
+    BADGERDB_TRACE2(file__read__done, filename().c_str(), first + i);
+    if (!allow_free && !pages[i]->isUsed()) {
+      throw InvalidPageException(first + i, filename());
+    }
+  }
 }
 
 void File::writePage(const Page& new_page) {
   PageHeader header = readPageHeader(new_page.page_number());
   if (header.current_page_number == Page::INVALID_NUMBER) {
     // Page has been deleted since it was read.
-    throw InvalidPageException(new_page.page_number(), filename_);
+    throw InvalidPageException(new_page.page_number(), filename());
   }
   // Page on disk may have had its next page pointer updated since it was read;
   // we don't modify that, but we do keep all the other modifications to the
@@ -181,7 +362,21 @@ void File::writePage(const Page& new_page) {
   writePage(new_page.page_number(), header, new_page);
 }
 
+void File::writePage(Page& page, std::uint64_t& seen) {
+  const std::uint64_t version = linkVersion();
+  if (version != seen) {
+    const PageHeader header = readPageHeader(page.page_number());
+    if (header.current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(page.page_number(), filename());
+    }
+    page.header_.next_page_number = header.next_page_number;
+    seen = version;
+  }
+  writePage(page.page_number(), page);
+}
+
 void File::deletePage(const PageId page_number) {
+  relink();
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
   Page previous_page;
@@ -199,16 +394,121 @@ void File::deletePage(const PageId page_number) {
       }
     }
   }
-  // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
-  ++header.num_free_pages;
   if (previous_page.isUsed()) {
     writePage(previous_page.page_number(), previous_page);
   }
-  writePage(page_number, existing_page);
+  if (header.flags & FileHeader::FLAG_PUNCH_HOLES) {
+    pushTrunkFree(header, page_number);
+  } else {
+    // Clear the page and add it to the head of the free list.
+    existing_page.initialize();
+    existing_page.set_next_page_number(header.first_free_page);
+    header.first_free_page = page_number;
+    writePage(page_number, existing_page);
+  }
+  ++header.num_free_pages;
+  writeHeader(header);
+}
+
+void File::setPunchHoles(const bool punch) {
+  FileHeader header = readHeader();
+  if (punch == ((header.flags & FileHeader::FLAG_PUNCH_HOLES) != 0)) {
+    return;
+  }
+  // The free list changes format, so it is read in the old one and written
+  // again in the new one.
+  std::vector<PageId> holding;
+  const std::vector<PageId> pages = freePages(header, holding);
+  if (punch) {
+    header.flags |= FileHeader::FLAG_PUNCH_HOLES;
+  } else {
+    header.flags &= ~FileHeader::FLAG_PUNCH_HOLES;
+  }
+  writeFreeList(header, pages, holding);
+  writeHeader(header);
+}
+
+bool File::punchHoles() const {
+  return (readHeader().flags & FileHeader::FLAG_PUNCH_HOLES) != 0;
+}
+
+void File::truncate(const PageId num_pages) {
+  FileHeader header = readHeader();
+  if (num_pages == 0 || num_pages > header.num_pages) {
+    throw InvalidPageException(num_pages, filename());
+  }
+  if (num_pages == header.num_pages) {
+    return;
+  }
+  relink();
+
+  // The used list is in page number order, so it is cut after the last used
+  // page that stays; its head stays unless every used page goes.
+  if (header.first_used_page != Page::INVALID_NUMBER &&
+      header.first_used_page < num_pages) {
+    PageId n = num_pages - 1;
+    PageHeader page_header = readPageHeader(n);
+    while (page_header.current_page_number != n) {
+      page_header = readPageHeader(--n);
+    }
+    if (page_header.next_page_number != Page::INVALID_NUMBER) {
+      page_header.next_page_number = Page::INVALID_NUMBER;
+      writeAt(&page_header, sizeof(page_header), pagePosition(n));
+    }
+  } else {
+    header.first_used_page = Page::INVALID_NUMBER;
+  }
+
+  if (header.flags & FileHeader::FLAG_PUNCH_HOLES) {
+    // The trunks list pages on either side of the new end; write them again
+    // with only the pages that stay.
+    std::vector<PageId> holding;
+    std::vector<PageId> pages = freePages(header, holding);
+    pages.erase(std::remove_if(pages.begin(), pages.end(),
+                               [num_pages](const PageId page_number) {
+                                 return page_number >= num_pages;
+                               }),
+                pages.end());
+    writeFreeList(header, pages, holding);
+    header.num_pages = num_pages;
+    writeHeader(header);
+    entry_->storage->truncate(pagePosition(num_pages));
+    return;
+  }
+
+  // The free list is in no order; relink the pages that stay, rewriting only
+  // the headers whose next pointer changes.
+  PageId next = header.first_free_page;
+  PageId tail = Page::INVALID_NUMBER;
+  PageHeader tail_header;
+  header.first_free_page = Page::INVALID_NUMBER;
+  header.num_free_pages = 0;
+  while (next != Page::INVALID_NUMBER) {
+    const PageId page_number = next;
+    const PageHeader page_header = readPageHeader(page_number);
+    next = page_header.next_page_number;
+    if (page_number >= num_pages) {
+      continue;
+    }
+    if (tail == Page::INVALID_NUMBER) {
+      header.first_free_page = page_number;
+    } else if (tail_header.next_page_number != page_number) {
+      tail_header.next_page_number = page_number;
+      writeAt(&tail_header, sizeof(tail_header), pagePosition(tail));
+    }
+    tail = page_number;
+    tail_header = page_header;
+    ++header.num_free_pages;
+  }
+  if (tail != Page::INVALID_NUMBER &&
+      tail_header.next_page_number != Page::INVALID_NUMBER) {
+    tail_header.next_page_number = Page::INVALID_NUMBER;
+    writeAt(&tail_header, sizeof(tail_header), pagePosition(tail));
+  }
+
+  header.num_pages = num_pages;
   writeHeader(header);
+  entry_->storage->truncate(pagePosition(num_pages));
 }
 
 FileIterator File::begin() {
@@ -220,86 +520,198 @@ FileIterator File::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
-
+File::File(const std::string& name, const bool create_new)
+    : entry_(FileRegistry::instance().acquire(name, create_new)) {
   if (create_new) {
-    // File starts with 1 page (the header).
-    FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
-    writeHeader(header);
+    writeNewHeader();
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
-  } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
-    if (create_new) {
-      // Error if we try to overwrite an existing file.
-      if (already_exists) {
-        throw FileExistsException(filename_);
-      }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
-    } else {
-      // Error if we try to open a file that doesn't exist.
-      if (!already_exists) {
-        throw FileNotFoundException(filename_);
-      }
-    }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
-  }
+void File::writeNewHeader() {
+  writeHeader(newHeader());
 }
 
-void File::close() {
-  --open_counts_[filename_];
-  stream_.reset();
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+void File::checkFormat() const {
+  const FileHeader header = readHeader();
+  if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+    throw FileFormatException(filename(),
+                              "no BadgerDB header (run badgerdb_upgrade on "
+                              "files from older versions)");
+  }
+  if (header.version != FileHeader::CURRENT_VERSION) {
+    throw FileFormatException(
+        filename(), "version " + std::to_string(header.version));
+  }
+  if (header.page_size != Page::SIZE) {
+    throw FileFormatException(
+        filename(), "page size " + std::to_string(header.page_size));
+  }
+  if ((header.flags & ~FileHeader::KNOWN_FLAGS) != 0) {
+    throw FileFormatException(
+        filename(), "unknown flags " + std::to_string(header.flags));
   }
 }
 
 void File::writePage(const PageId page_number, const Page& new_page) {
-  writePage(page_number, new_page.header_, new_page);
+  // A Page object is the page as it is on disk.
+  BADGERDB_TRACE2(file__write__start, filename().c_str(), page_number);
+  writeAt(&new_page, Page::SIZE, pagePosition(page_number));
+  BADGERDB_TRACE2(file__write__done, filename().c_str(), page_number);
 }
 
 void File::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  BADGERDB_TRACE2(file__write__start, filename().c_str(), page_number);
+  struct iovec iov[2];
+  iov[0].iov_base = const_cast<PageHeader*>(&header);
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = const_cast<char*>(new_page.data_);
+  iov[1].iov_len = Page::DATA_SIZE;
+  entry_->storage->writev(iov, 2, pagePosition(page_number));
+  BADGERDB_TRACE2(file__write__done, filename().c_str(), page_number);
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  readAt(&header, sizeof(header), 0 /* offset */);
 
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->flush();
+  writeAt(&header, sizeof(header), 0 /* offset */);
+}
+
+void File::pushTrunkFree(FileHeader& header, const PageId page_number) {
+  entry_->storage->discard(pagePosition(page_number), Page::SIZE);
+  if (header.first_free_page != Page::INVALID_NUMBER) {
+    const off_t trunk = pagePosition(header.first_free_page);
+    std::uint32_t count;
+    readAt(&count, sizeof(count), trunk + offsetof(TrunkHeader, count));
+    if (count < TRUNK_CAPACITY) {
+      writeAt(&page_number, sizeof(page_number),
+              trunk + sizeof(TrunkHeader) + count * sizeof(PageId));
+      ++count;
+      writeAt(&count, sizeof(count), trunk + offsetof(TrunkHeader, count));
+      return;
+    }
+  }
+  // No room in the head trunk, so the page becomes the new head.
+  TrunkHeader trunk_header;
+  std::memset(&trunk_header, 0, sizeof(trunk_header));
+  trunk_header.header.next_page_number = header.first_free_page;
+  writeAt(&trunk_header, sizeof(trunk_header), pagePosition(page_number));
+  header.first_free_page = page_number;
+}
+
+PageId File::popTrunkFree(FileHeader& header) {
+  const PageId trunk_number = header.first_free_page;
+  const off_t trunk = pagePosition(trunk_number);
+  TrunkHeader trunk_header;
+  readAt(&trunk_header, sizeof(trunk_header), trunk);
+  if (trunk_header.count == 0) {
+    header.first_free_page = trunk_header.header.next_page_number;
+    return trunk_number;
+  }
+  --trunk_header.count;
+  PageId page_number;
+  readAt(&page_number, sizeof(page_number),
+         trunk + sizeof(TrunkHeader) + trunk_header.count * sizeof(PageId));
+  writeAt(&trunk_header.count, sizeof(trunk_header.count),
+          trunk + offsetof(TrunkHeader, count));
+  return page_number;
+}
+
+std::vector<PageId> File::freePages(const FileHeader& header,
+                                    std::vector<PageId>& holding) const {
+  const bool trunks = (header.flags & FileHeader::FLAG_PUNCH_HOLES) != 0;
+  std::vector<PageId> pages;
+  PageId next = header.first_free_page;
+  while (next != Page::INVALID_NUMBER) {
+    const off_t position = pagePosition(next);
+    TrunkHeader trunk_header;
+    trunk_header.count = 0;
+    readAt(&trunk_header,
+           trunks ? sizeof(trunk_header) : sizeof(trunk_header.header),
+           position);
+    pages.push_back(next);
+    holding.push_back(next);
+    if (trunk_header.count > 0) {
+      const std::size_t first = pages.size();
+      pages.resize(first + trunk_header.count);
+      readAt(&pages[first], trunk_header.count * sizeof(PageId),
+             position + sizeof(TrunkHeader));
+    }
+    next = trunk_header.header.next_page_number;
+  }
+  return pages;
+}
+
+void File::writeFreeList(FileHeader& header, const std::vector<PageId>& pages,
+                         std::vector<PageId> holding) {
+  header.num_free_pages = pages.size();
+  header.first_free_page =
+      pages.empty() ? Page::INVALID_NUMBER : pages.front();
+  if (!(header.flags & FileHeader::FLAG_PUNCH_HOLES)) {
+    // Pages that held trunks are cleared; punched pages already read as
+    // zero and only need their header.
+    std::sort(holding.begin(), holding.end());
+    Page free_page;
+    for (std::size_t i = 0; i < pages.size(); ++i) {
+      free_page.set_next_page_number(
+          i + 1 < pages.size() ? pages[i + 1] : Page::INVALID_NUMBER);
+      if (std::binary_search(holding.begin(), holding.end(), pages[i])) {
+        writePage(pages[i], free_page);
+      } else {
+        writeAt(&free_page.header_, sizeof(free_page.header_),
+                pagePosition(pages[i]));
+      }
+    }
+    return;
+  }
+
+  // Every TRUNK_CAPACITY + 1 pages, the first is a trunk listing the rest.
+  // Pages still holding data are punched out; trunks too, before their
+  // start is written again.
+  std::sort(holding.begin(), holding.end());
+  std::vector<char> trunk(Page::SIZE);
+  for (std::size_t start = 0; start < pages.size();
+       start += TRUNK_CAPACITY + 1) {
+    const std::size_t next = start + TRUNK_CAPACITY + 1;
+    TrunkHeader trunk_header;
+    std::memset(&trunk_header, 0, sizeof(trunk_header));
+    trunk_header.header.next_page_number =
+        next < pages.size() ? pages[next] : Page::INVALID_NUMBER;
+    trunk_header.count = std::min(next, pages.size()) - start - 1;
+    for (std::size_t i = start; i <= start + trunk_header.count; ++i) {
+      if (std::binary_search(holding.begin(), holding.end(), pages[i])) {
+        entry_->storage->discard(pagePosition(pages[i]), Page::SIZE);
+      }
+    }
+    std::memcpy(trunk.data(), &trunk_header, sizeof(trunk_header));
+    std::memcpy(trunk.data() + sizeof(trunk_header), pages.data() + start + 1,
+                trunk_header.count * sizeof(PageId));
+    writeAt(trunk.data(),
+            sizeof(trunk_header) + trunk_header.count * sizeof(PageId),
+            pagePosition(pages[start]));
+  }
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  readAt(&header, sizeof(header), pagePosition(page_number));
 
   return header;
 }
 
+void File::readAt(void* buffer, const std::size_t length,
+                  const off_t offset) const {
+  entry_->storage->read(buffer, length, offset);
+}
+
+void File::writeAt(const void* buffer, const std::size_t length,
+                   const off_t offset) {
+  entry_->storage->write(buffer, length, offset);
+}
+
 }
@@ -7,23 +7,71 @@
 
 #pragma once
 
-#include <fstream>
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <map>
-#include <memory>
+#include <vector>
 
+#include "file_registry.h"
 #include "page.h"
 
 namespace badgerdb {
 
 class FileIterator;
+class IoExecutor;
+struct SegmentLayout;
 
 /**
  * @brief Header metadata for files on disk which contain pages.
+ *
+ * The header fills page 0 of the file; page n starts at byte n * Page::SIZE.
+ * It is written as it is in memory, little-endian, with the layout pinned by
+ * the static_asserts below.  Files written before the header was versioned
+ * (a bare 16-byte header followed by the pages) are format version 1 and are
+ * converted by File::upgrade() or the badgerdb_upgrade tool.
  */
 struct FileHeader {
   /**
-   * Number of pages allocated in the file.
+   * Format version written by this build.
+   */
+  static const std::uint32_t CURRENT_VERSION = 2;
+
+  /**
+   * Flag: deleted pages have their space returned to the filesystem; see
+   * File::setPunchHoles().
+   */
+  static const std::uint32_t FLAG_PUNCH_HOLES = 1;
+
+  /**
+   * Flags this build understands.
+   */
+  static const std::uint32_t KNOWN_FLAGS = FLAG_PUNCH_HOLES;
+
+  /**
+   * Identifies a BadgerDB file: "BDBFILE" and a NUL.
+   */
+  char magic[8];
+
+  /**
+   * Format version of the file.
+   */
+  std::uint32_t version;
+
+  /**
+   * Page size the file was written with.
+   */
+  std::uint32_t page_size;
+
+  /**
+   * Feature flags, FLAG_*; files with flags outside KNOWN_FLAGS are refused.
+   */
+  std::uint32_t flags;
+
+  /**
+   * Number of pages allocated in the file, including the header page.
    */
   PageId num_pages;
 
@@ -39,9 +87,17 @@ struct FileHeader {
 
   /**
    * Page number of the first free (allocated but unused) page in the file.
+   * Free pages are chained through their next page pointers; with
+   * FLAG_PUNCH_HOLES only the free-list trunks are chained, each listing
+   * further free pages in its data area.
    */
   PageId first_free_page;
 
+  /**
+   * Always zero.
+   */
+  std::uint32_t reserved;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -56,19 +112,33 @@ struct FileHeader {
   }
 };
 
+static_assert(sizeof(FileHeader) == 40 &&
+              offsetof(FileHeader, version) == 8 &&
+              offsetof(FileHeader, page_size) == 12 &&
+              offsetof(FileHeader, flags) == 16 &&
+              offsetof(FileHeader, num_pages) == 20 &&
+              offsetof(FileHeader, first_free_page) == 32,
+              "FileHeader layout changed; this changes the file format.");
+static_assert(sizeof(FileHeader) <= Page::SIZE,
+              "File header must fit in the header page.");
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
- * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * The File class wraps a descriptor for an underlying file on disk.  Files
+ * contain fixed-sized pages, and they never deallocate space (though they do
+ * reuse deleted pages if possible).  If multiple File objects refer to the
+ * same underlying file, they share one descriptor, held by the FileRegistry.
+ * If a file has already been opened (possibly by another query), then the
+ * File class finds it in the registry and just returns a file object
+ * referring to the already open descriptor without actually opening the UNIX
+ * file again.
  *
- * @warning This class is not threadsafe.
+ * Opening, copying and closing File objects is threadsafe, and pages are read
+ * and written with positioned I/O, so concurrent reads and writes of
+ * different pages do not interfere.  Allocating and deleting pages update the
+ * file's page lists and must not run concurrently on the same file.
  */
 class File {
  public:
@@ -80,18 +150,45 @@ class File {
    */
   static File create(const std::string& filename);
 
+  /**
+   * Creates a new file split into segment files of layout.segment_size
+   * bytes, striped over layout.directories.  The file is opened, removed
+   * and used like any other; only its storage differs.
+   *
+   * @param filename  Name of the file; holds the segment manifest.
+   * @param layout    Segment size and directories.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static File createSegmented(const std::string& filename,
+                              const SegmentLayout& layout);
+
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+   * If the file is already open, the new File object shares the descriptor
+   * of the open file and the file's reference count in the FileRegistry is
+   * incremented.  Otherwise the UNIX file is actually opened.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileFormatException     If the file's header doesn't match the
+   *                                  format of this build.
    */
   static File open(const std::string& filename);
 
+  /**
+   * Converts a file written in format version 1 (before the header was
+   * versioned) to the current format, in place.  The file must not be open.
+   * Pages are moved one at a time, so a crash part way leaves the file
+   * unreadable; keep a copy until this returns.
+   *
+   * @param filename  Name of the file.
+   * @return  True if the file was converted, false if it already had the
+   *          current format.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileFormatException     If the file is neither format.
+   */
+  static bool upgrade(const std::string& filename);
+
   /**
    * Deletes an existing file.
    *
@@ -102,7 +199,8 @@ class File {
   static void remove(const std::string& filename);
 
   /**
-   * Returns true if the file exists and is open.
+   * Returns true if some File object has the file open.  This only consults
+   * the FileRegistry and does not touch the filesystem.
    *
    * @param filename  Name of the file.
    */
@@ -110,7 +208,8 @@ class File {
 
 
   /**
-   * Returns true if the file exists and is open.
+   * Returns true if the file exists.  This is a single stat() call; the file
+   * is not opened.
    *
    * @param filename  Name of the file.
    */
@@ -155,15 +254,73 @@ class File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads <count> adjacent pages, starting at <first>, into <pages> with a
+   * single vectored read.
+   *
+   * @param first   Number of the first page to read.
+   * @param count   Number of pages to read.
+   * @param pages   Destinations of the pages, one per page; need not be
+   *                adjacent in memory.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const PageId first, const std::size_t count,
+                 Page* const pages[]) const;
+
+  /**
+   * Reads the pages in <page_numbers>, in any order, into <pages>.  Each run
+   * of adjacent page numbers is read with one vectored read; if <io> is given
+   * the runs are submitted to it and read concurrently.
+   *
+   * @param page_numbers  Numbers of the pages to read.
+   * @param pages         Destinations of the pages, pages[i] receiving page
+   *                      page_numbers[i].
+   * @param io            Executor to read runs on, or NULL to read them on
+   *                      the calling thread.  This waits for all tasks
+   *                      submitted to it.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file or is not currently used.
+   */
+  void readPages(const std::vector<PageId>& page_numbers,
+                 Page* const pages[], IoExecutor* io = NULL) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
+   * The next page pointer on disk is kept: nothing says when the caller read
+   * its copy, so the page header is read first and the write takes two I/O
+   * calls.  Buffer pools write back with the overload below, which takes one.
    *
    * @see allocatePage()
    * @param new_page  Page to write.
+   * @throws  InvalidPageException  If the page has been deleted.
    */
   void writePage(const Page& new_page);
 
+  /**
+   * Same as above, for a caller that keeps its copy of the page between the
+   * read and the write.  While <seen> is still the file's link version, the
+   * copy's next page pointer is the one on disk and the page is written with
+   * a single I/O call; otherwise the pointer is first refreshed from disk,
+   * in <page> itself, and <seen> is moved on.
+   *
+   * @param page  Page to write.
+   * @param seen  Link version taken before the page was read or allocated.
+   * @throws  InvalidPageException  If the page has been deleted since.
+   */
+  void writePage(Page& page, std::uint64_t& seen);
+
+  /**
+   * Returns the link version of the file.  It changes before allocatePage(),
+   * deletePage() or truncate() rewrite the next page pointer of any page, so
+   * a copy of a page read after the version was taken holds the pointer on
+   * disk for as long as the version stays the same.
+   */
+  std::uint64_t linkVersion() const {
+    return entry_->link_version.load(std::memory_order_acquire);
+  }
+
   /**
    * Deletes a page from the file.
    *
@@ -171,12 +328,54 @@ class File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Shrinks the file to its first <num_pages> pages, header included.  Pages
+   * past the new end are discarded whether used or free, and their space is
+   * returned to the filesystem in one operation.  Reads only the headers of
+   * the free pages (the free-list trunks, when holes are punched) and of the
+   * used pages between the new end and the last
+   * used page before it; nothing is read from the pages discarded.
+   *
+   * @param num_pages   New number of pages, at least 1.
+   * @throws  InvalidPageException  If <num_pages> is zero or larger than the
+   *                                file.
+   */
+  void truncate(const PageId num_pages);
+
+  /**
+   * Sets whether deletePage() returns the space of deleted pages to the
+   * filesystem by punching a hole over each, so that disk usage follows the
+   * pages in use.  The free list is then kept in trunk pages, free pages
+   * that each list up to about two thousand others, so a deleted page is
+   * punched out whole and nothing is written back into the hole; the hole
+   * is filled again when the page is reallocated.  Changing the setting
+   * rewrites the free list in the other form, and turning it on punches out
+   * the pages already free.  The setting is kept in the file header, and
+   * builds that predate it refuse to open a file that has it set.
+   *
+   * @param punch   Whether to punch holes.
+   */
+  void setPunchHoles(const bool punch);
+
+  /**
+   * Returns whether deletePage() punches holes.
+   */
+  bool punchHoles() const;
+
   /**
    * Returns the name of the file this object represents.
    *
    * @return Name of file.
    */
-  const std::string& filename() const { return filename_; }
+  const std::string& filename() const { return entry_->name; }
+
+  /**
+   * Returns the id the FileRegistry assigned to the file.  All File objects
+   * for the same file have the same id.
+   *
+   * @return Id of file.
+   */
+  FileId id() const { return entry_->id; }
 
   /**
    * Returns an iterator at the first page in the file.
@@ -201,8 +400,8 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  static off_t pagePosition(const PageId page_number) {
+    return static_cast<off_t>(page_number) * Page::SIZE;
   }
 
   /**
@@ -222,31 +421,53 @@ class File {
   File(const std::string& name, const bool create_new);
 
   /**
-   * Opens the underlying file named in filename_.
-   * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * Constructs a file object from a registry entry, taking over a reference
+   * the caller acquired on it.
    *
-   * @param create_new  Whether to create a new file.
-   * @throws  FileExistsException     If the underlying file exists and
-   *                                  create_new is true.
-   * @throws  FileNotFoundException   If the underlying file doesn't exist and
-   *                                  create_new is false.
+   * @param entry Entry of an open file.
    */
-  void openIfNeeded(const bool create_new);
+  explicit File(FileRegistry::Entry* entry) : entry_(entry) {}
 
   /**
-   * Closes the underlying file stream in <stream_>.
-   * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * Writes the header of a new, empty file.
+   */
+  void writeNewHeader();
+
+  /**
+   * Checks the header of an existing file against the current format.
+   *
+   * @throws  FileFormatException   If the header doesn't match.
    */
-  void close();
+  void checkFormat() const;
+
+  /**
+   * Reads <length> bytes at <offset> from the file.  Bytes past the end of
+   * the file read as zero.
+   *
+   * @param buffer  Destination of the data.
+   * @param length  Number of bytes to read.
+   * @param offset  Position in the file to read from.
+   * @throws  FileIOException   If the read fails.
+   */
+  void readAt(void* buffer, const std::size_t length, const off_t offset) const;
+
+  /**
+   * Writes <length> bytes at <offset> into the file.
+   *
+   * @param buffer  Data to write.
+   * @param length  Number of bytes to write.
+   * @param offset  Position in the file to write to.
+   * @throws  FileIOException   If the write fails.
+   */
+  void writeAt(const void* buffer, const std::size_t length,
+               const off_t offset);
 
   /**
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -256,6 +477,20 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads <count> adjacent pages, starting at <first>, with one vectored
+   * read, without bounds checking.
+   *
+   * @param first       Number of the first page to read.
+   * @param count       Number of pages to read.
+   * @param pages       Destinations of the pages.
+   * @param allow_free  Whether to allow reading free (unused) pages.
+   * @throws  InvalidPageException  If a page is free (unused) and allow_free
+   *                                is false.
+   */
+  void readRun(const PageId first, const std::size_t count,
+               Page* const pages[], const bool allow_free) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -293,40 +528,76 @@ class File {
   void writeHeader(const FileHeader& header);
 
   /**
-   * Reads only the header of the given page from disk (not the record data
-   * or slot table).  No bounds checking is performed.
+   * Moves the link version on; called before any next page pointer changes.
+   */
+  void relink() {
+    entry_->link_version.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  /**
+   * Adds a deleted page to the trunk form of the free list and punches it
+   * out.  The page becomes the head trunk if the head trunk is full.
    *
-   * @param page_number   Number of page whose header is to be read.
-   * @return  Header of page.
+   * @param header        File header; its first free page is updated.
+   * @param page_number   Number of the deleted page.
    */
-  PageHeader readPageHeader(const PageId page_number) const;
+  void pushTrunkFree(FileHeader& header, const PageId page_number);
 
-  typedef std::map<std::string,
-                   std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Takes a page from the trunk form of the free list: the last page the
+   * head trunk lists, or the head trunk itself if it lists none.
+   *
+   * @param header  File header with a free page; its first free page is
+   *                updated.
+   * @return  Number of the page taken.
+   */
+  PageId popTrunkFree(FileHeader& header);
 
   /**
-   * Streams for opened files.
+   * Returns the numbers of all free pages, reading the free list in the form
+   * <header> says it is in.
+   *
+   * @param header    File header.
+   * @param holding   Receives the free pages whose space holds free-list
+   *                  data and is not punched out.
+   * @return  Free pages, in free-list order.
    */
-  static StreamMap open_streams_;
+  std::vector<PageId> freePages(const FileHeader& header,
+                                std::vector<PageId>& holding) const;
 
   /**
-   * Counts for opened files.
+   * Writes a free list of <pages> in the form <header> says; in the trunk
+   * form, pages that don't become trunks are punched out.  Sets the free
+   * list fields of <header> but doesn't write it.
+   *
+   * @param header    File header.
+   * @param pages     Free pages.
+   * @param holding   Pages whose space isn't punched out, as returned by
+   *                  freePages().
    */
-  static CountMap open_counts_;
+  void writeFreeList(FileHeader& header, const std::vector<PageId>& pages,
+                     std::vector<PageId> holding);
 
   /**
-   * Name of the file this object represents.
+   * Reads only the header of the given page from disk (not the record data
+   * or slot table).  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be read.
+   * @return  Header of page.
    */
-  std::string filename_;
+  PageHeader readPageHeader(const PageId page_number) const;
 
   /**
-   * Stream for underlying filesystem object.
+   * Registry entry of the underlying file; holds its name and descriptor.
+   * This object owns one reference to it.
    */
-  std::shared_ptr<std::fstream> stream_;
+  FileRegistry::Entry* entry_;
 
+  friend class BufMgr;
   friend class FileIterator;
   friend class FileTest;
+  friend class Tablespace;
+  friend class VmBufMgr;
 };
 
 }
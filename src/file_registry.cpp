@@ -0,0 +1,196 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_registry.h"
+
+#include <stdexcept>
+
+#include "exceptions/file_exists_exception.h"
+#include "exceptions/file_open_exception.h"
+#include "segmented_storage.h"
+
+namespace badgerdb {
+
+FileRegistry& FileRegistry::instance() {
+  // Never destroyed: File objects with static storage duration may still
+  // release their entries after main returns.
+  static FileRegistry* registry = new FileRegistry();
+  return *registry;
+}
+
+FileRegistry::FileRegistry() : count_(0) {
+  for (std::uint32_t i = 0; i < MAX_CHUNKS; ++i) {
+    chunks_[i].store(NULL, std::memory_order_relaxed);
+  }
+}
+
+FileRegistry::Entry* FileRegistry::intern(const std::string& filename,
+                                          FileId& id) {
+  std::lock_guard<std::mutex> guard(names_latch_);
+  std::unordered_map<std::string, Entry*>::const_iterator it =
+      names_.find(filename);
+  if (it != names_.end()) {
+    id = it->second->id.load(std::memory_order_relaxed);
+    return it->second;
+  }
+
+  Entry* entry;
+  if (!free_.empty()) {
+    // Nothing finds a retired entry by name or id any more.
+    entry = free_.back();
+    free_.pop_back();
+    entry->name = filename;
+  } else {
+    const std::uint32_t index = count_.load(std::memory_order_relaxed);
+    const std::uint32_t chunk = index >> CHUNK_BITS;
+    if (chunk >= MAX_CHUNKS) {
+      throw std::length_error("too many files open or known at once");
+    }
+    Entry** slots = chunks_[chunk].load(std::memory_order_relaxed);
+    if (slots == NULL) {
+      slots = new Entry*[CHUNK_SIZE]();
+      chunks_[chunk].store(slots, std::memory_order_release);
+    }
+    entry = new Entry(index, filename);
+    slots[index & (CHUNK_SIZE - 1)] = entry;
+    count_.store(index + 1, std::memory_order_release);
+  }
+  names_.insert(std::make_pair(filename, entry));
+  id = entry->id.load(std::memory_order_relaxed);
+  return entry;
+}
+
+FileRegistry::Entry* FileRegistry::find(const std::string& filename,
+                                        FileId& id) const {
+  std::lock_guard<std::mutex> guard(names_latch_);
+  std::unordered_map<std::string, Entry*>::const_iterator it =
+      names_.find(filename);
+  if (it == names_.end()) {
+    return NULL;
+  }
+  id = it->second->id.load(std::memory_order_relaxed);
+  return it->second;
+}
+
+void FileRegistry::retire(Entry* entry) {
+  std::lock_guard<std::mutex> guard(names_latch_);
+  names_.erase(entry->name);
+  const FileId id = entry->id.load(std::memory_order_relaxed);
+  const FileId generation = (id >> INDEX_BITS) + 1;
+  entry->id.store((generation << INDEX_BITS) | (id & INDEX_MASK),
+                  std::memory_order_release);
+  // The last generation is never handed out: once the others are used up
+  // the entry stays retired, rather than let an id come round again.
+  if (generation < GENERATIONS - 1) {
+    free_.push_back(entry);
+  }
+}
+
+std::string FileRegistry::name(const FileId id) const {
+  std::lock_guard<std::mutex> guard(names_latch_);
+  const Entry* found = entry(id);
+  return found == NULL ? std::string("(removed file)") : found->name;
+}
+
+FileRegistry::Entry* FileRegistry::acquire(const std::string& filename,
+                                           const bool create_new) {
+  return acquire(filename, create_new, &openFileStorage);
+}
+
+FileRegistry::Entry* FileRegistry::acquire(const std::string& filename,
+                                           const bool create_new,
+                                           const Opener& open) {
+  FileId id;
+  Entry* entry = intern(filename, id);
+  std::unique_lock<std::mutex> guard(entry->open_latch);
+  while (entry->id.load(std::memory_order_relaxed) != id) {
+    // Removed while we were waiting; the name has a new entry by now.
+    guard.unlock();
+    entry = intern(filename, id);
+    guard = std::unique_lock<std::mutex>(entry->open_latch);
+  }
+  if (entry->storage) {
+    // Already open (or about to be closed by a release that is waiting for
+    // this latch, which will see the new reference and leave it open).
+    if (create_new) {
+      throw FileExistsException(entry->name);
+    }
+  } else {
+    entry->storage.reset(open(entry->name, create_new));
+  }
+  entry->refs.fetch_add(1, std::memory_order_relaxed);
+  return entry;
+}
+
+FileRegistry::Entry* FileRegistry::tryAcquire(const FileId id) {
+  Entry* entry = this->entry(id);
+  if (entry == NULL) {
+    return NULL;
+  }
+  // The descriptor stays open while the count is above zero, so only take a
+  // reference if somebody else still holds one.
+  int refs = entry->refs.load(std::memory_order_acquire);
+  while (refs > 0) {
+    if (entry->refs.compare_exchange_weak(refs, refs + 1,
+                                          std::memory_order_acq_rel)) {
+      if (entry->id.load(std::memory_order_acquire) != id) {
+        // The file was removed and the entry reused since the lookup.
+        release(entry);
+        return NULL;
+      }
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+void FileRegistry::release(Entry* entry) {
+  if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(entry->open_latch);
+  // Somebody may have reopened the file between the decrement and the latch.
+  if (entry->refs.load(std::memory_order_acquire) == 0) {
+    entry->storage.reset();
+  }
+}
+
+void FileRegistry::remove(const std::string& filename) {
+  remove(filename, &removeFileStorage);
+}
+
+void FileRegistry::remove(const std::string& filename,
+                          const Remover& destroy) {
+  for (;;) {
+    FileId id;
+    Entry* entry = find(filename, id);
+    if (entry == NULL) {
+      // Not open, and no pool holds pages under an id for it.
+      destroy(filename);
+      return;
+    }
+    std::lock_guard<std::mutex> guard(entry->open_latch);
+    if (entry->id.load(std::memory_order_relaxed) != id) {
+      // Removed while we were waiting.
+      continue;
+    }
+    if (entry->refs.load(std::memory_order_acquire) > 0) {
+      throw FileOpenException(entry->name);
+    }
+    destroy(entry->name);
+    retire(entry);
+    return;
+  }
+}
+
+bool FileRegistry::isOpen(const std::string& filename) const {
+  FileId id;
+  const Entry* entry = find(filename, id);
+  return entry != NULL && entry->refs.load(std::memory_order_acquire) > 0;
+}
+
+}
@@ -0,0 +1,301 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "storage.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Process-wide table of the files BadgerDB has opened.
+ *
+ * Every filename is interned the first time it is opened or created and
+ * given a FileId that stays the same for as long as the file exists, even
+ * across close and reopen.  Removing the file retires its id: a file created
+ * later, under the same name or another, gets a new one, so pages of the old
+ * file still in a buffer pool are never taken for pages of the new one.  The
+ * entry of a removed file is reused for a later name with its generation,
+ * the high bits of the id, moved on, so the registry grows with the number
+ * of names known at once rather than with every file ever created.  The
+ * entry for a file holds its
+ * Storage and a count of the File objects that use it; the storage is
+ * opened when the count goes from zero to one and closed when it drops back
+ * to zero.
+ *
+ * Looking an entry up by id, and taking or dropping a reference to an entry
+ * that is already open, are lock-free.  Only interning a name and the
+ * open/close transitions take a lock, so copying File objects is cheap and
+ * files may be opened and closed from several threads at once.
+ */
+class FileRegistry {
+ public:
+  /**
+   * @brief Registry record for one filename.
+   */
+  struct Entry {
+    /**
+     * Constructs an entry for a file that is not open.
+     */
+    Entry(const FileId entry_id, const std::string& entry_name)
+        : id(entry_id), name(entry_name), refs(0), link_version(0) {}
+
+    /**
+     * Id of the file; changes, under open_latch, when the file is removed.
+     */
+    std::atomic<FileId> id;
+
+    /**
+     * Name of the file.  Stable while the caller holds a reference; replaced
+     * under the registry's names latch when the entry is reused.
+     */
+    std::string name;
+
+    /**
+     * Number of File objects referring to this file.
+     */
+    std::atomic<int> refs;
+
+    /**
+     * Bumped before a File rewrites the next page pointer of any page of the
+     * file; see File::linkVersion().
+     */
+    std::atomic<std::uint64_t> link_version;
+
+    /**
+     * Backing store of the open file, or NULL if it is closed.  Stable while
+     * the caller holds a reference.
+     */
+    std::unique_ptr<Storage> storage;
+
+    /**
+     * Serializes opening, closing and removing the file.
+     */
+    std::mutex open_latch;
+  };
+
+  /**
+   * Opens the storage of a file, creating it if <create_new> is set.  Called
+   * with the file's interned name, which outlives the storage.
+   */
+  typedef std::function<Storage*(const std::string& name,
+                                 const bool create_new)> Opener;
+
+  /**
+   * Destroys the storage of a closed file.
+   */
+  typedef std::function<void(const std::string& name)> Remover;
+
+  /**
+   * Returns the registry shared by the whole process.
+   */
+  static FileRegistry& instance();
+
+  /**
+   * Opens (or creates) the named file if it is not open already and returns
+   * its entry with one more reference.  Segmented files are recognized by
+   * their manifest; see openFileStorage().
+   *
+   * @param filename    Name of the file.
+   * @param create_new  Whether to create a new file.
+   * @throws  FileExistsException     If create_new is set and the file
+   *                                  already exists.
+   * @throws  FileNotFoundException   If create_new is not set and the file
+   *                                  doesn't exist.
+   * @throws  FileIOException         If the operating system refuses to open
+   *                                  the file.
+   */
+  Entry* acquire(const std::string& filename, const bool create_new);
+
+  /**
+   * Same as above, but for files that don't live on the filesystem under
+   * their own name: <open> creates
+   * the storage when the file is not open already.
+   *
+   * @param filename    Name the file is registered under.
+   * @param create_new  Whether to create a new file.
+   * @param open        Opens the file's storage.
+   */
+  Entry* acquire(const std::string& filename, const bool create_new,
+                 const Opener& open);
+
+  /**
+   * Takes a reference to the file with the given id if it is open.
+   *
+   * @param id  Id handed out by the registry.
+   * @return  The file's entry with one more reference, or NULL if no File
+   *          object has the file open.
+   */
+  Entry* tryAcquire(const FileId id);
+
+  /**
+   * Takes another reference to an entry the caller already holds one on.
+   *
+   * @param entry Entry to reference.
+   */
+  static void addRef(Entry* entry) {
+    entry->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Drops a reference to an entry, closing the file if it was the last one.
+   *
+   * @param entry Entry to release.
+   */
+  void release(Entry* entry);
+
+  /**
+   * Deletes the named file from the filesystem and retires its id.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileOpenException       If the file is currently open.
+   */
+  void remove(const std::string& filename);
+
+  /**
+   * Same as above, but for files that don't live on the filesystem under
+   * their own name.
+   *
+   * @param filename  Name the file is registered under.
+   * @param destroy   Deletes the file's storage.
+   * @throws  FileOpenException       If the file is currently open.
+   */
+  void remove(const std::string& filename, const Remover& destroy);
+
+  /**
+   * Returns true if some File object currently has the named file open.
+   *
+   * @param filename  Name of the file.
+   */
+  bool isOpen(const std::string& filename) const;
+
+  /**
+   * Returns the entry with the given id.
+   *
+   * @param id  Id handed out by the registry.
+   * @return  Entry for the id, or NULL if no file has that id, or the file
+   *          that had it has been removed.
+   */
+  Entry* entry(const FileId id) const {
+    const std::uint32_t index = FileRegistry::index(id);
+    if (index >= count_.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    Entry* found = chunks_[index >> CHUNK_BITS].load(
+        std::memory_order_acquire)[index & (CHUNK_SIZE - 1)];
+    return found->id.load(std::memory_order_acquire) == id ? found : NULL;
+  }
+
+  /**
+   * Returns the position of the id's entry among all entries; ids of files
+   * that existed at different times may share it.  Less than size().
+   *
+   * @param id  Id handed out by the registry.
+   */
+  static std::uint32_t index(const FileId id) { return id & INDEX_MASK; }
+
+  /**
+   * Returns the name of the file with the given id, for messages.  Safe to
+   * call with the id of a file that may be removed meanwhile.
+   *
+   * @param id  Id handed out by the registry.
+   * @return  Name of the file, or a placeholder if it has been removed.
+   */
+  std::string name(const FileId id) const;
+
+  /**
+   * Returns the number of entries allocated, in use or awaiting reuse.
+   */
+  std::uint32_t size() const { return count_.load(std::memory_order_acquire); }
+
+ private:
+  /**
+   * Entries are kept in fixed-size chunks that are never moved or freed, so
+   * lookups by id can run concurrently with interning new names.
+   */
+  static const std::uint32_t CHUNK_BITS = 10;
+  static const std::uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+  static const std::uint32_t MAX_CHUNKS = 4096;
+
+  /**
+   * The low bits of an id select the entry, the rest are its generation.
+   */
+  static const std::uint32_t INDEX_BITS = 22;
+  static const FileId INDEX_MASK = (1u << INDEX_BITS) - 1;
+  static const FileId GENERATIONS = 1u << (32 - INDEX_BITS);
+
+  static_assert(CHUNK_SIZE * MAX_CHUNKS == 1u << INDEX_BITS,
+                "every entry needs an index");
+
+  FileRegistry();
+
+  FileRegistry(const FileRegistry&) = delete;
+  FileRegistry& operator=(const FileRegistry&) = delete;
+
+  /**
+   * Returns the entry for the filename, creating it if needed, reusing the
+   * entry of a removed file if there is one.
+   *
+   * @param filename  Name of the file.
+   * @param id        Set to the id of the file.
+   */
+  Entry* intern(const std::string& filename, FileId& id);
+
+  /**
+   * Returns the entry for the filename, or NULL if it is not interned.
+   *
+   * @param filename  Name of the file.
+   * @param id        Set to the id of the file.
+   */
+  Entry* find(const std::string& filename, FileId& id) const;
+
+  /**
+   * Retires the id of a removed file and frees its entry for reuse.  Called
+   * with the entry's open_latch held.
+   */
+  void retire(Entry* entry);
+
+  /**
+   * Protects names_, free_, the creation and reuse of entries and their
+   * names.
+   */
+  mutable std::mutex names_latch_;
+
+  /**
+   * Interned filenames.
+   */
+  std::unordered_map<std::string, Entry*> names_;
+
+  /**
+   * Entries of removed files, ready for reuse.
+   */
+  std::vector<Entry*> free_;
+
+  /**
+   * Entry chunks, indexed by the high bits of the id.
+   */
+  std::atomic<Entry**> chunks_[MAX_CHUNKS];
+
+  /**
+   * Number of entries allocated.
+   */
+  std::atomic<std::uint32_t> count_;
+};
+
+}
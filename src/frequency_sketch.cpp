@@ -0,0 +1,79 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "frequency_sketch.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Odd multipliers, one per row, so that each row hashes a key differently.
+ */
+const std::uint64_t ROW_SEEDS[FrequencySketch::DEPTH] = {
+  0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full,
+  0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull
+};
+
+}
+
+std::uint32_t FrequencySketch::widthFor(const std::uint32_t capacity) {
+  std::uint32_t width = 64;
+  while (width < capacity && width < (1u << 30)) {
+    width <<= 1;
+  }
+  return width;
+}
+
+FrequencySketch::FrequencySketch(MemoryBudget* budget,
+                                 const std::uint32_t capacity)
+    : width_(widthFor(capacity)),
+      sample_size_(capacity < 0x10000000 ? capacity * 10 : 0xFFFFFFFF),
+      additions_(0),
+      counters_(budget, MemoryBudget::OTHER,
+                static_cast<std::size_t>(widthFor(capacity)) * DEPTH) {}
+
+std::uint32_t FrequencySketch::index(const PageKey key,
+                                     const std::uint32_t row) const {
+  // width_ is a power of two; the high bits of the product are the best mixed
+  return static_cast<std::uint32_t>((key * ROW_SEEDS[row]) >> 32) &
+      (width_ - 1);
+}
+
+void FrequencySketch::increment(const PageKey key) {
+  bool added = false;
+  for (std::uint32_t row = 0; row < DEPTH; ++row) {
+    std::uint8_t& counter = counters_[row * width_ + index(key, row)];
+    if (counter < MAX_COUNT) {
+      ++counter;
+      added = true;
+    }
+  }
+  if (added && ++additions_ >= sample_size_) {
+    age();
+  }
+}
+
+std::uint32_t FrequencySketch::frequency(const PageKey key) const {
+  std::uint32_t estimate = MAX_COUNT;
+  for (std::uint32_t row = 0; row < DEPTH; ++row) {
+    const std::uint32_t count = counters_[row * width_ + index(key, row)];
+    if (count < estimate) {
+      estimate = count;
+    }
+  }
+  return estimate;
+}
+
+void FrequencySketch::age() {
+  for (std::size_t i = 0; i < counters_.size(); ++i) {
+    counters_[i] >>= 1;
+  }
+  additions_ /= 2;
+}
+
+}
@@ -0,0 +1,99 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "memory_budget.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Approximate access counts of pages over the recent past.
+ *
+ * A count-min sketch: DEPTH rows of small saturating counters, each page
+ * hashing to one counter per row, its estimate being the smallest of them.
+ * Counters saturate at MAX_COUNT, and after every 10 * <capacity> increments
+ * all of them are halved, so the counts follow the recent workload rather
+ * than its whole history.  Memory is a few bytes per page of capacity and is
+ * reserved against a budget.
+ */
+class FrequencySketch {
+ public:
+  /**
+   * Largest count a counter holds.
+   */
+  static const std::uint8_t MAX_COUNT = 15;
+
+  /**
+   * Number of rows.
+   */
+  static const std::uint32_t DEPTH = 4;
+
+  /**
+   * Creates a sketch sized for a pool of <capacity> pages.
+   *
+   * @throws  MemoryBudgetExceededException If the budget can't cover it.
+   */
+  FrequencySketch(MemoryBudget* budget, const std::uint32_t capacity);
+
+  /**
+   * Bytes a sketch for <capacity> pages charges to its budget.
+   */
+  static std::uint64_t bytesFor(const std::uint32_t capacity) {
+    return TrackedArray<std::uint8_t>::bytesFor(widthFor(capacity) * DEPTH);
+  }
+
+  /**
+   * Counts one access to a page.
+   */
+  void increment(const PageKey key);
+
+  /**
+   * Returns the estimated number of recent accesses to a page.
+   */
+  std::uint32_t frequency(const PageKey key) const;
+
+  /**
+   * Returns the bytes charged to the budget.
+   */
+  std::uint64_t bytes() const { return counters_.bytes(); }
+
+ private:
+  /**
+   * Counters per row: a power of two at least <capacity>.
+   */
+  static std::uint32_t widthFor(const std::uint32_t capacity);
+
+  /**
+   * Position of a page's counter in row <row>.
+   */
+  std::uint32_t index(const PageKey key, const std::uint32_t row) const;
+
+  /**
+   * Halves every counter.
+   */
+  void age();
+
+  const std::uint32_t width_;
+
+  /**
+   * Increments after which the counters are aged.
+   */
+  const std::uint32_t sample_size_;
+
+  std::uint32_t additions_;
+
+  /**
+   * DEPTH rows of width_ counters, row after row.
+   */
+  TrackedArray<std::uint8_t> counters_;
+};
+
+}
@@ -0,0 +1,94 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_executor.h"
+
+#include <utility>
+
+namespace badgerdb {
+
+IoExecutor::IoExecutor(const unsigned threads)
+    : outstanding_(0), stopping_(false) {
+  const unsigned count = threads > 0 ? threads : 1;
+  workers_.reserve(count);
+  for (unsigned i = 0; i < count; ++i) {
+    workers_.push_back(std::thread(&IoExecutor::run, this));
+  }
+}
+
+IoExecutor::~IoExecutor() {
+  {
+    std::unique_lock<std::mutex> lock(latch_);
+    idle_cv_.wait(lock, [this]() { return outstanding_ == 0; });
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+void IoExecutor::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    queue_.push_back(std::move(task));
+    ++outstanding_;
+  }
+  work_cv_.notify_one();
+}
+
+void IoExecutor::wait() {
+  std::unique_lock<std::mutex> lock(latch_);
+  idle_cv_.wait(lock, [this]() { return outstanding_ == 0; });
+  rethrowLocked();
+}
+
+bool IoExecutor::waitFor(const std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(latch_);
+  if (!idle_cv_.wait_for(lock, timeout,
+                         [this]() { return outstanding_ == 0; })) {
+    return false;
+  }
+  rethrowLocked();
+  return true;
+}
+
+void IoExecutor::rethrowLocked() {
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = std::exception_ptr();
+    std::rethrow_exception(error);
+  }
+}
+
+void IoExecutor::run() {
+  std::unique_lock<std::mutex> lock(latch_);
+  while (true) {
+    work_cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    try {
+      task();
+    } catch (...) {
+      lock.lock();
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+      lock.unlock();
+    }
+    lock.lock();
+    if (--outstanding_ == 0) {
+      idle_cv_.notify_all();
+    }
+  }
+}
+
+}
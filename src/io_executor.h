@@ -0,0 +1,122 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Fixed pool of threads that run blocking I/O tasks.
+ *
+ * Tasks are run in submission order by whichever thread is free.  If a task
+ * throws, the first exception is kept and rethrown by wait(); later tasks
+ * still run.
+ *
+ * @code
+ *   IoExecutor io(4);
+ *   for (...) io.submit([&]() { file.writePage(page); });
+ *   io.wait();
+ * @endcode
+ */
+class IoExecutor {
+ public:
+  /**
+   * Starts the worker threads.
+   *
+   * @param threads Number of threads; at least one is started.
+   */
+  explicit IoExecutor(const unsigned threads);
+
+  /**
+   * Waits for queued tasks to finish and stops the threads.  Exceptions that
+   * were not collected with wait() are discarded.
+   */
+  ~IoExecutor();
+
+  IoExecutor(const IoExecutor&) = delete;
+  IoExecutor& operator=(const IoExecutor&) = delete;
+
+  /**
+   * Queues a task.
+   *
+   * @param task  Function to run on one of the threads.
+   */
+  void submit(std::function<void()> task);
+
+  /**
+   * Blocks until every task submitted so far has finished.
+   *
+   * @throws  Whatever the first failing task threw.
+   */
+  void wait();
+
+  /**
+   * Waits up to <timeout> for every task submitted so far to finish.
+   *
+   * @param timeout Longest time to wait.
+   * @return  True if all tasks finished; false on timeout.
+   * @throws  Whatever the first failing task threw, once all tasks finished.
+   */
+  bool waitFor(const std::chrono::milliseconds timeout);
+
+  /**
+   * Returns the number of worker threads.
+   */
+  std::size_t threads() const { return workers_.size(); }
+
+ private:
+  /**
+   * Body of each worker thread.
+   */
+  void run();
+
+  /**
+   * Rethrows and clears the stored task exception, if any.  Caller holds
+   * latch_.
+   */
+  void rethrowLocked();
+
+  std::mutex latch_;
+
+  /**
+   * Signalled when a task is queued or the pool is stopping.
+   */
+  std::condition_variable work_cv_;
+
+  /**
+   * Signalled when the last outstanding task finishes.
+   */
+  std::condition_variable idle_cv_;
+
+  std::deque<std::function<void()> > queue_;
+
+  /**
+   * Tasks queued or running.
+   */
+  std::size_t outstanding_;
+
+  bool stopping_;
+
+  /**
+   * First exception thrown by a task since the last wait().
+   */
+  std::exception_ptr error_;
+
+  std::vector<std::thread> workers_;
+};
+
+}
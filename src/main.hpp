@@ -39,7 +39,8 @@
  *
  * To build and run the system, you need the following packages:
  * <ul>
- *   <li>A modern C++ compiler (GCC >= 4.6, any recent version of clang)
+ *   <li>A C++17 compiler (GCC >= 7, any recent version of clang)
+ *   <li>CMake 3.13 or higher
  *   <li>Doxygen 1.6 or higher (for generating documentation only)
  * </ul>
  *
@@ -58,11 +59,15 @@
  *   $ make
  * @endcode
  *
+ * This drives a CMake build in <code>build/</code>; pass
+ * <code>BUILD_TYPE=...</code> or <code>CMAKE_ARGS=...</code> to change the
+ * configuration, or run <code>make test</code> to build and run the tests.
+ *
  * @subsection modify_run_main_sec Modifying and running main
  *
  * To run the executable, first build the code, then run:
  * @code
- *   $ ./src/badgerdb_main
+ *   $ ./build/badgerdb_main
  * @endcode
  *
  * If you want to edit what <code>badgerdb_main</code> does, edit
@@ -0,0 +1,39 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "memory_budget.h"
+
+#include "exceptions/memory_budget_exceeded_exception.h"
+
+namespace badgerdb {
+
+MemoryBudget::MemoryBudget(const std::uint64_t limit)
+    : limit_(limit), total_(0) {
+  for (int i = 0; i < NUM_CATEGORIES; ++i) {
+    used_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void MemoryBudget::reserve(const Category category,
+                           const std::uint64_t bytes) {
+  std::uint64_t used = total_.load(std::memory_order_relaxed);
+  do {
+    if (bytes > limit_ - used) {
+      throw MemoryBudgetExceededException(bytes, used, limit_);
+    }
+  } while (!total_.compare_exchange_weak(used, used + bytes,
+                                         std::memory_order_relaxed));
+  used_[category].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryBudget::release(const Category category,
+                           const std::uint64_t bytes) {
+  used_[category].fetch_sub(bytes, std::memory_order_relaxed);
+  total_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,250 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace badgerdb {
+
+/**
+ * @brief Byte budget shared by the structures charged to it.
+ *
+ * Every long-lived allocation of a buffer pool (frames, descriptors, hash
+ * table) is reserved against a budget before it is made and released when it
+ * is freed, so the budget always knows how much memory is in use and refuses
+ * requests past its limit.  One budget may be shared by several BufMgr
+ * objects to cap a whole process.
+ *
+ * @code
+ *   MemoryBudget budget(256 << 20);
+ *   BufMgr pool(BufMgr::framesForBudget(budget.limit()), &budget);
+ *   std::cout << budget.used(MemoryBudget::FRAMES) << "\n";
+ * @endcode
+ *
+ * All methods are threadsafe.
+ */
+class MemoryBudget {
+ public:
+  /**
+   * What memory is used for, for reporting.
+   */
+  enum Category {
+    FRAMES,
+    DESCRIPTORS,
+    HASH_TABLE,
+    OTHER,
+    NUM_CATEGORIES
+  };
+
+  /**
+   * Limit of a budget that only tracks usage.
+   */
+  static const std::uint64_t UNLIMITED =
+      std::numeric_limits<std::uint64_t>::max();
+
+  /**
+   * Constructs a budget.
+   *
+   * @param limit Most bytes that may be reserved at once.
+   */
+  explicit MemoryBudget(const std::uint64_t limit = UNLIMITED);
+
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+  /**
+   * Reserves <bytes> for <category>.
+   *
+   * @throws  MemoryBudgetExceededException If the reservation would exceed
+   *                                        the limit; nothing is reserved.
+   */
+  void reserve(const Category category, const std::uint64_t bytes);
+
+  /**
+   * Returns bytes reserved earlier for <category>.
+   */
+  void release(const Category category, const std::uint64_t bytes);
+
+  /**
+   * Returns the limit.
+   */
+  std::uint64_t limit() const { return limit_; }
+
+  /**
+   * Returns the bytes reserved in total.
+   */
+  std::uint64_t used() const { return total_.load(std::memory_order_relaxed); }
+
+  /**
+   * Returns the bytes reserved for <category>.
+   */
+  std::uint64_t used(const Category category) const {
+    return used_[category].load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns the bytes that can still be reserved.
+   */
+  std::uint64_t available() const { return limit_ - used(); }
+
+ private:
+  const std::uint64_t limit_;
+
+  std::atomic<std::uint64_t> total_;
+
+  std::atomic<std::uint64_t> used_[NUM_CATEGORIES];
+};
+
+/**
+ * @brief Bytes reserved against a budget for the lifetime of this object.
+ */
+class MemoryReservation {
+ public:
+  /**
+   * Reserves <bytes> for <category> in <budget>.
+   *
+   * @throws  MemoryBudgetExceededException If the budget can't cover them.
+   */
+  MemoryReservation(MemoryBudget* budget, const MemoryBudget::Category category,
+                    const std::uint64_t bytes)
+      : budget_(budget), category_(category), bytes_(bytes) {
+    budget_->reserve(category_, bytes_);
+  }
+
+  /**
+   * Releases the bytes.
+   */
+  ~MemoryReservation() { budget_->release(category_, bytes_); }
+
+  MemoryReservation(const MemoryReservation&) = delete;
+  MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+  /**
+   * Returns the bytes reserved.
+   */
+  std::uint64_t bytes() const { return bytes_; }
+
+ private:
+  MemoryBudget* const budget_;
+
+  const MemoryBudget::Category category_;
+
+  const std::uint64_t bytes_;
+};
+
+/**
+ * @brief Fixed-size array whose memory is reserved against a budget before it
+ *        is allocated.  Elements are value-initialized.
+ */
+template <class T>
+class TrackedArray {
+ public:
+  /**
+   * Reserves and allocates <size> elements.
+   *
+   * @throws  MemoryBudgetExceededException If the budget can't cover them.
+   */
+  TrackedArray(MemoryBudget* budget, const MemoryBudget::Category category,
+               const std::size_t size)
+      : reservation_(budget, category, bytesFor(size)),
+        data_(new T[size]()),
+        size_(size) {}
+
+  /**
+   * Bytes charged for an array of <size> elements.
+   */
+  static std::uint64_t bytesFor(const std::size_t size) {
+    return static_cast<std::uint64_t>(size) * sizeof(T);
+  }
+
+  T* data() { return data_.get(); }
+  const T* data() const { return data_.get(); }
+
+  T& operator[](const std::size_t i) { return data_[i]; }
+  const T& operator[](const std::size_t i) const { return data_[i]; }
+
+  std::size_t size() const { return size_; }
+
+  /**
+   * Returns the bytes charged to the budget.
+   */
+  std::uint64_t bytes() const { return reservation_.bytes(); }
+
+ private:
+  MemoryReservation reservation_;
+
+  std::unique_ptr<T[]> data_;
+
+  const std::size_t size_;
+};
+
+/**
+ * @brief Fixed pool of objects handed out and returned one at a time, with
+ *        all of its memory reserved up front.
+ *
+ * Objects are not constructed or destroyed on allocate and free; callers
+ * assign every member they use.
+ */
+template <class T>
+class Arena {
+ public:
+  /**
+   * Reserves and allocates room for <capacity> objects.
+   *
+   * @throws  MemoryBudgetExceededException If the budget can't cover them.
+   */
+  Arena(MemoryBudget* budget, const MemoryBudget::Category category,
+        const std::size_t capacity)
+      : slots_(budget, category, capacity),
+        free_(budget, category, capacity),
+        num_free_(capacity) {
+    for (std::size_t i = 0; i < capacity; ++i) {
+      free_[i] = &slots_[capacity - 1 - i];
+    }
+  }
+
+  /**
+   * Bytes charged for an arena of <capacity> objects.
+   */
+  static std::uint64_t bytesFor(const std::size_t capacity) {
+    return TrackedArray<T>::bytesFor(capacity) +
+        TrackedArray<T*>::bytesFor(capacity);
+  }
+
+  /**
+   * Returns an unused object, or NULL if all are in use.
+   */
+  T* allocate() { return num_free_ == 0 ? NULL : free_[--num_free_]; }
+
+  /**
+   * Returns an object handed out by allocate().
+   */
+  void free(T* object) { free_[num_free_++] = object; }
+
+  std::size_t capacity() const { return slots_.size(); }
+
+  std::size_t inUse() const { return slots_.size() - num_free_; }
+
+  /**
+   * Returns the bytes charged to the budget.
+   */
+  std::uint64_t bytes() const { return slots_.bytes() + free_.bytes(); }
+
+ private:
+  TrackedArray<T> slots_;
+
+  TrackedArray<T*> free_;
+
+  std::size_t num_free_;
+};
+
+}
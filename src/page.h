@@ -76,10 +76,15 @@ struct PageHeader {
  */
 struct PageSlot {
   /**
-   * Whether the slot currently holds data.  May be false if this slot's
-   * record has been deleted after insertion.
+   * Whether the slot currently holds data (0 or 1).  May be false if this
+   * slot's record has been deleted after insertion.
    */
-  bool used;
+  std::uint8_t used;
+
+  /**
+   * Always zero; makes the byte before item_offset explicit.
+   */
+  std::uint8_t reserved;
 
   /**
    * Offset of the data item in the page.
@@ -92,6 +97,23 @@ struct PageSlot {
   std::uint16_t item_length;
 };
 
+/*
+ * PageHeader and PageSlot are written to disk as they are in memory.  Their
+ * layouts are pinned here so that they don't depend on the compiler, and
+ * multi-byte fields are little-endian, which is the only byte order built.
+ */
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "On-disk format is little-endian; big-endian hosts unsupported.");
+static_assert(sizeof(PageHeader) == 16 &&
+              offsetof(PageHeader, num_slots) == 4 &&
+              offsetof(PageHeader, current_page_number) == 8 &&
+              offsetof(PageHeader, next_page_number) == 12,
+              "PageHeader layout changed; this changes the file format.");
+static_assert(sizeof(PageSlot) == 6 &&
+              offsetof(PageSlot, item_offset) == 2 &&
+              offsetof(PageSlot, item_length) == 4,
+              "PageSlot layout changed; this changes the file format.");
+
 class PageIterator;
 
 /**
@@ -327,10 +349,10 @@ class Page {
 
   /**
    * Data stored on the page.  Includes bookkeeping information about slots as
-   * well as actual content.
+   * well as actual content.  Follows the header directly, so the page object
+   * is byte for byte the page on disk.
    */
-
-  std::string data_;
+  char data_[DATA_SIZE];
 
   friend class File;
   friend class PageIterator;
@@ -342,5 +364,7 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page object must have the size of a page on disk.");
 
 }
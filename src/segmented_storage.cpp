@@ -0,0 +1,383 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "segmented_storage.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include "exceptions/file_io_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+const char MAGIC[8] = {'B', 'D', 'B', 'S', 'E', 'G', 'M', '\0'};
+
+const std::uint32_t VERSION = 1;
+
+/**
+ * @brief Fixed part of the manifest; followed by each directory as a 32-bit
+ *        length and its bytes.
+ */
+struct ManifestHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t num_directories;
+  std::uint64_t segment_size;
+  std::uint32_t num_segments;
+  std::uint32_t reserved;
+};
+
+/**
+ * Smallest segment size accepted: one page of the smallest size we support.
+ */
+const std::uint64_t MIN_SEGMENT_SIZE = 4096;
+
+std::string dirname(const std::string& path) {
+  const std::size_t slash = path.rfind('/');
+  if (slash == std::string::npos) {
+    return ".";
+  }
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+std::string basename(const std::string& path) {
+  const std::size_t slash = path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/**
+ * Reads the manifest of a segmented file.
+ */
+void readManifest(const std::string& filename, PosixStorage& manifest,
+                  SegmentLayout& layout, std::uint32_t& num_segments) {
+  ManifestHeader header;
+  manifest.read(&header, sizeof(header), 0);
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION || header.segment_size < MIN_SEGMENT_SIZE) {
+    throw FileIOException(filename, "open of segment manifest", EINVAL);
+  }
+  layout.segment_size = header.segment_size;
+  layout.directories.clear();
+  off_t position = sizeof(header);
+  for (std::uint32_t i = 0; i < header.num_directories; ++i) {
+    std::uint32_t length;
+    manifest.read(&length, sizeof(length), position);
+    position += sizeof(length);
+    if (length > 4096) {
+      throw FileIOException(filename, "open of segment manifest", EINVAL);
+    }
+    std::string directory(length, '\0');
+    manifest.read(&directory[0], length, position);
+    position += length;
+    layout.directories.push_back(directory);
+  }
+  num_segments = header.num_segments;
+}
+
+}
+
+SegmentedStorage* SegmentedStorage::create(const std::string& filename,
+                                           const SegmentLayout& layout) {
+  if (layout.segment_size < MIN_SEGMENT_SIZE) {
+    throw FileIOException(filename, "create", EINVAL);
+  }
+  std::unique_ptr<PosixStorage> manifest(PosixStorage::open(filename, true));
+  SegmentedStorage* storage =
+      new SegmentedStorage(filename, manifest.release(), layout, 0);
+  storage->writeManifest();
+  return storage;
+}
+
+SegmentedStorage* SegmentedStorage::open(const std::string& filename,
+                                         PosixStorage* manifest) {
+  std::unique_ptr<PosixStorage> owned(manifest);
+  SegmentLayout layout;
+  std::uint32_t num_segments;
+  readManifest(filename, *owned, layout, num_segments);
+  return new SegmentedStorage(filename, owned.release(), layout,
+                              num_segments);
+}
+
+bool SegmentedStorage::isManifest(PosixStorage& file) {
+  char magic[sizeof(MAGIC)];
+  file.read(magic, sizeof(magic), 0);
+  return std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void SegmentedStorage::remove(const std::string& filename,
+                              PosixStorage* manifest) {
+  std::unique_ptr<SegmentedStorage> storage(open(filename, manifest));
+  for (std::uint32_t i = 0; i < storage->num_segments_; ++i) {
+    const std::string path = storage->segmentPath(i);
+    if (::unlink(path.c_str()) != 0 && errno != ENOENT) {
+      throw FileIOException(filename, "remove of segment " + path, errno);
+    }
+  }
+  storage.reset();
+  PosixStorage::remove(filename);
+}
+
+SegmentedStorage::SegmentedStorage(const std::string& filename,
+                                   PosixStorage* manifest,
+                                   const SegmentLayout& layout,
+                                   const std::uint32_t num_segments)
+    : filename_(filename),
+      manifest_(manifest),
+      layout_(layout),
+      num_segments_(num_segments) {
+}
+
+SegmentedStorage::~SegmentedStorage() {
+}
+
+SegmentedStorage::SegmentFd::~SegmentFd() {
+  ::close(fd);
+}
+
+std::string SegmentedStorage::segmentPath(const std::uint32_t segment) const {
+  std::stringstream ss;
+  if (layout_.directories.empty()) {
+    ss << dirname(filename_);
+  } else {
+    ss << layout_.directories[segment % layout_.directories.size()];
+  }
+  ss << "/" << basename(filename_) << "." << segment;
+  return ss.str();
+}
+
+void SegmentedStorage::writeManifest() {
+  ManifestHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.num_directories = layout_.directories.size();
+  header.segment_size = layout_.segment_size;
+  header.num_segments = num_segments_;
+
+  std::string bytes(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (std::size_t i = 0; i < layout_.directories.size(); ++i) {
+    const std::uint32_t length = layout_.directories[i].size();
+    bytes.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    bytes.append(layout_.directories[i]);
+  }
+  manifest_->write(bytes.data(), bytes.size(), 0);
+}
+
+std::shared_ptr<const SegmentedStorage::SegmentFd>
+SegmentedStorage::segmentFd(const std::uint32_t segment, const bool create) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (segment < segment_fds_.size() && segment_fds_[segment]) {
+    return segment_fds_[segment];
+  }
+  if (!create && segment >= num_segments_) {
+    return NULL;
+  }
+
+  const std::string path = segmentPath(segment);
+  int fd;
+  do {
+    fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0),
+                0666);
+  } while (fd < 0 && errno == EINTR);
+  if (fd < 0) {
+    if (errno == ENOENT && !create) {
+      // Never written; reads as zeroes.
+      return NULL;
+    }
+    throw FileIOException(filename_, "open of segment " + path, errno);
+  }
+  std::shared_ptr<const SegmentFd> opened(new SegmentFd(fd));
+  if (segment_fds_.size() <= segment) {
+    segment_fds_.resize(segment + 1);
+  }
+  segment_fds_[segment] = opened;
+  if (segment >= num_segments_) {
+    num_segments_ = segment + 1;
+    writeManifest();
+  }
+  return opened;
+}
+
+void SegmentedStorage::read(void* buffer, const std::size_t length,
+                            const off_t offset) {
+  char* dest = static_cast<char*>(buffer);
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t position = offset + done;
+    const std::uint32_t segment = position / layout_.segment_size;
+    const off_t within = position % layout_.segment_size;
+    const std::size_t piece = std::min<std::uint64_t>(
+        length - done, layout_.segment_size - within);
+    const std::shared_ptr<const SegmentFd> fd = segmentFd(segment, false);
+    if (!fd) {
+      std::memset(dest + done, 0, piece);
+    } else {
+      preadFully(fd->fd, dest + done, piece, within, filename_);
+    }
+    done += piece;
+  }
+}
+
+void SegmentedStorage::write(const void* buffer, const std::size_t length,
+                             const off_t offset) {
+  const char* src = static_cast<const char*>(buffer);
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t position = offset + done;
+    const std::uint32_t segment = position / layout_.segment_size;
+    const off_t within = position % layout_.segment_size;
+    const std::size_t piece = std::min<std::uint64_t>(
+        length - done, layout_.segment_size - within);
+    pwriteFully(segmentFd(segment, true)->fd, src + done, piece, within,
+                filename_);
+    done += piece;
+  }
+}
+
+void SegmentedStorage::mapRuns(
+    const struct iovec* iov, const int count, const off_t offset,
+    const std::function<void(const std::vector<struct iovec>&,
+                             const std::uint32_t, const off_t)>& run) const {
+  std::vector<struct iovec> pieces;
+  std::uint32_t run_segment = 0;
+  off_t run_start = 0;
+  std::uint64_t position = offset;
+  for (int i = 0; i < count; ++i) {
+    char* base = static_cast<char*>(iov[i].iov_base);
+    std::size_t done = 0;
+    while (done < iov[i].iov_len) {
+      const std::uint32_t segment = position / layout_.segment_size;
+      const off_t within = position % layout_.segment_size;
+      const std::size_t piece = std::min<std::uint64_t>(
+          iov[i].iov_len - done, layout_.segment_size - within);
+      if (!pieces.empty() && segment != run_segment) {
+        run(pieces, run_segment, run_start);
+        pieces.clear();
+      }
+      if (pieces.empty()) {
+        run_segment = segment;
+        run_start = within;
+      }
+      const struct iovec io = {base + done, piece};
+      pieces.push_back(io);
+      done += piece;
+      position += piece;
+    }
+  }
+  if (!pieces.empty()) {
+    run(pieces, run_segment, run_start);
+  }
+}
+
+void SegmentedStorage::readv(const struct iovec* iov, const int count,
+                             const off_t offset) {
+  mapRuns(iov, count, offset,
+          [this](const std::vector<struct iovec>& pieces,
+                 const std::uint32_t segment, const off_t within) {
+            const std::shared_ptr<const SegmentFd> fd =
+                segmentFd(segment, false);
+            if (!fd) {
+              // Never written; reads as zeroes.
+              for (std::size_t i = 0; i < pieces.size(); ++i) {
+                std::memset(pieces[i].iov_base, 0, pieces[i].iov_len);
+              }
+            } else {
+              preadvFully(fd->fd, &pieces[0], static_cast<int>(pieces.size()),
+                          within, filename_);
+            }
+          });
+}
+
+void SegmentedStorage::writev(const struct iovec* iov, const int count,
+                              const off_t offset) {
+  mapRuns(iov, count, offset,
+          [this](const std::vector<struct iovec>& pieces,
+                 const std::uint32_t segment, const off_t within) {
+            pwritevFully(segmentFd(segment, true)->fd, &pieces[0],
+                         static_cast<int>(pieces.size()), within, filename_);
+          });
+}
+
+void SegmentedStorage::discard(const off_t offset, const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t position = offset + done;
+    const std::uint32_t segment = position / layout_.segment_size;
+    const off_t within = position % layout_.segment_size;
+    const std::size_t piece = std::min<std::uint64_t>(
+        length - done, layout_.segment_size - within);
+    const std::shared_ptr<const SegmentFd> fd = segmentFd(segment, false);
+    if (fd) {
+      punchHole(fd->fd, within, piece, filename_);
+    }
+    done += piece;
+  }
+}
+
+void SegmentedStorage::truncate(const off_t length) {
+  // Segments dropped here are closed once the last read or write still using
+  // them finishes; I/O on the bytes that stay is unaffected.
+  std::lock_guard<std::mutex> guard(latch_);
+  const std::uint64_t size = length;
+  const std::uint32_t keep =
+      (size + layout_.segment_size - 1) / layout_.segment_size;
+  for (std::uint32_t i = keep; i < num_segments_; ++i) {
+    if (i < segment_fds_.size()) {
+      segment_fds_[i].reset();
+    }
+    const std::string path = segmentPath(i);
+    if (::unlink(path.c_str()) != 0 && errno != ENOENT) {
+      throw FileIOException(filename_, "remove of segment " + path, errno);
+    }
+  }
+  if (keep < num_segments_) {
+    num_segments_ = keep;
+    writeManifest();
+  }
+  if (keep > 0 && size % layout_.segment_size != 0) {
+    const std::string path = segmentPath(keep - 1);
+    if (::truncate(path.c_str(), size % layout_.segment_size) != 0 &&
+        errno != ENOENT) {
+      throw FileIOException(filename_, "truncate of segment " + path, errno);
+    }
+  }
+}
+
+Storage* openFileStorage(const std::string& filename, const bool create_new) {
+  PosixStorage* file = PosixStorage::open(filename, create_new);
+  if (create_new) {
+    return file;
+  }
+  try {
+    if (SegmentedStorage::isManifest(*file)) {
+      return SegmentedStorage::open(filename, file);
+    }
+  } catch (...) {
+    delete file;
+    throw;
+  }
+  return file;
+}
+
+void removeFileStorage(const std::string& filename) {
+  std::unique_ptr<PosixStorage> file(PosixStorage::open(filename, false));
+  if (SegmentedStorage::isManifest(*file)) {
+    SegmentedStorage::remove(filename, file.release());
+  } else {
+    file.reset();
+    PosixStorage::remove(filename);
+  }
+}
+
+}
@@ -0,0 +1,223 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "storage.h"
+
+namespace badgerdb {
+
+/**
+ * @brief How a segmented file is split over OS files.
+ */
+struct SegmentLayout {
+  /**
+   * Default size of each segment file: 1 GiB.
+   */
+  static const std::uint64_t DEFAULT_SEGMENT_SIZE = 1ull << 30;
+
+  SegmentLayout() : segment_size(DEFAULT_SEGMENT_SIZE) {}
+
+  /**
+   * Bytes of the logical file stored in each segment file.
+   */
+  std::uint64_t segment_size;
+
+  /**
+   * Directories segment files are striped over, segment i going to
+   * directories[i % size].  Empty means the directory of the file itself.
+   */
+  std::vector<std::string> directories;
+};
+
+/**
+ * @brief Storage of one logical file split into fixed-size segment files.
+ *
+ * The file's own name holds a small manifest (segment size, directories and
+ * number of segments); segment i lives in
+ * "<directory>/<file basename>.<i>", striped round-robin over the
+ * directories so that I/O to different parts of the file can proceed on
+ * different devices at once.  Segment files are created when first written
+ * and opened when first touched.
+ */
+class SegmentedStorage : public Storage {
+ public:
+  /**
+   * Creates the manifest of a new segmented file.
+   *
+   * @param filename  Name of the file; must outlive the storage.
+   * @param layout    Segment size and directories.
+   * @throws  FileExistsException   If the file already exists.
+   */
+  static SegmentedStorage* create(const std::string& filename,
+                                  const SegmentLayout& layout);
+
+  /**
+   * Opens the segmented file whose manifest is <manifest>, which is
+   * consumed.
+   *
+   * @param filename  Name of the file; must outlive the storage.
+   * @param manifest  Open manifest file.
+   * @throws  FileIOException   If the manifest is malformed.
+   */
+  static SegmentedStorage* open(const std::string& filename,
+                                PosixStorage* manifest);
+
+  /**
+   * Returns true if the open file is the manifest of a segmented file.
+   *
+   * @param file  Open file.
+   */
+  static bool isManifest(PosixStorage& file);
+
+  /**
+   * Deletes the segment files and the manifest of the segmented file whose
+   * manifest is <manifest>, which is consumed.
+   *
+   * @param filename  Name of the file.
+   * @param manifest  Open manifest file.
+   */
+  static void remove(const std::string& filename, PosixStorage* manifest);
+
+  /**
+   * Closes the manifest and all segment files.
+   */
+  ~SegmentedStorage();
+
+  void read(void* buffer, const std::size_t length, const off_t offset);
+
+  void write(const void* buffer, const std::size_t length,
+             const off_t offset);
+
+  /**
+   * Reads with one preadv per segment the bytes fall in.
+   */
+  void readv(const struct iovec* iov, const int count, const off_t offset);
+
+  /**
+   * Writes with one pwritev per segment the bytes fall in.
+   */
+  void writev(const struct iovec* iov, const int count, const off_t offset);
+
+  /**
+   * Deletes the segment files wholly past <length> and shrinks the one it
+   * falls in.
+   */
+  void truncate(const off_t length);
+
+  /**
+   * Punches holes in the segment files the bytes fall in.
+   */
+  void discard(const off_t offset, const std::size_t length);
+
+  /**
+   * Returns the layout of the file.
+   */
+  const SegmentLayout& layout() const { return layout_; }
+
+  /**
+   * Returns the path of segment file <segment>.
+   */
+  std::string segmentPath(const std::uint32_t segment) const;
+
+ private:
+  SegmentedStorage(const std::string& filename, PosixStorage* manifest,
+                   const SegmentLayout& layout,
+                   const std::uint32_t num_segments);
+
+  /**
+   * Writes the manifest.
+   */
+  void writeManifest();
+
+  /**
+   * Splits <count> buffers holding consecutive bytes of the file, starting
+   * at <offset>, into runs that each lie within one segment, and calls <run>
+   * with each run, its segment and its position in the segment.
+   */
+  void mapRuns(const struct iovec* iov, const int count, const off_t offset,
+               const std::function<void(const std::vector<struct iovec>&,
+                                        const std::uint32_t, const off_t)>&
+                   run) const;
+
+  /**
+   * @brief Open descriptor of a segment file, closed when the last user lets
+   *        go of it.
+   */
+  struct SegmentFd {
+    explicit SegmentFd(const int segment_fd) : fd(segment_fd) {}
+    ~SegmentFd();
+
+    const int fd;
+  };
+
+  /**
+   * Returns the descriptor of a segment file, opening it if needed.  If
+   * <create> is not set and the segment file doesn't exist, returns NULL.
+   * Callers hold on to the result for the duration of their I/O, so that
+   * truncate() dropping the segment does not close the descriptor under
+   * them, or let its number be reused for another file.
+   */
+  std::shared_ptr<const SegmentFd> segmentFd(const std::uint32_t segment,
+                                             const bool create);
+
+  const std::string& filename_;
+
+  std::unique_ptr<PosixStorage> manifest_;
+
+  const SegmentLayout layout_;
+
+  /**
+   * Protects segment_fds_ and num_segments_.
+   */
+  std::mutex latch_;
+
+  /**
+   * Descriptors of the segment files opened so far, NULL if not open.
+   */
+  std::vector<std::shared_ptr<const SegmentFd> > segment_fds_;
+
+  /**
+   * Number of segments recorded in the manifest; segments at or above this
+   * have never been written.
+   */
+  std::uint32_t num_segments_;
+};
+
+/**
+ * Opens the storage of a file named on the filesystem: the segments of a
+ * segmented file if <filename> holds a manifest, the OS file itself
+ * otherwise.  New files are plain OS files.  This is the default
+ * FileRegistry::Opener.
+ *
+ * @throws  FileExistsException     If create_new is set and the file already
+ *                                  exists.
+ * @throws  FileNotFoundException   If create_new is not set and the file
+ *                                  doesn't exist.
+ */
+Storage* openFileStorage(const std::string& filename, const bool create_new);
+
+/**
+ * Deletes a file named on the filesystem, with all its segment files if it
+ * is segmented.  This is the default FileRegistry::Remover.
+ *
+ * @throws  FileNotFoundException   If the file doesn't exist.
+ */
+void removeFileStorage(const std::string& filename);
+
+}
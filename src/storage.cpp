@@ -0,0 +1,237 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "storage.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+void preadFully(const int fd, void* buffer, const std::size_t length,
+                const off_t offset, const std::string& filename) {
+  char* dest = static_cast<char*>(buffer);
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pread(fd, dest + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, "read", errno);
+    }
+    if (n == 0) {
+      // End of file.
+      std::memset(dest + done, 0, length - done);
+      break;
+    }
+    done += n;
+  }
+}
+
+void preadvFully(const int fd, const struct iovec* iov, const int count,
+                 const off_t offset, const std::string& filename) {
+  // Short reads advance through a copy of the buffer list.
+  std::vector<struct iovec> rest(iov, iov + count);
+  std::size_t next = 0;
+  off_t position = offset;
+  while (next < rest.size()) {
+    const int batch =
+        static_cast<int>(std::min<std::size_t>(rest.size() - next, IOV_MAX));
+    const ssize_t n = ::preadv(fd, &rest[next], batch, position);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, "read", errno);
+    }
+    if (n == 0) {
+      // End of file.
+      for (; next < rest.size(); ++next) {
+        std::memset(rest[next].iov_base, 0, rest[next].iov_len);
+      }
+      break;
+    }
+    position += n;
+    std::size_t done = n;
+    while (next < rest.size() && done >= rest[next].iov_len) {
+      done -= rest[next].iov_len;
+      ++next;
+    }
+    if (done > 0) {
+      rest[next].iov_base = static_cast<char*>(rest[next].iov_base) + done;
+      rest[next].iov_len -= done;
+    }
+  }
+}
+
+void pwriteFully(const int fd, const void* buffer, const std::size_t length,
+                 const off_t offset, const std::string& filename) {
+  const char* src = static_cast<const char*>(buffer);
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pwrite(fd, src + done, length - done, offset + done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, "write", errno);
+    }
+    done += n;
+  }
+}
+
+void pwritevFully(const int fd, const struct iovec* iov, const int count,
+                  const off_t offset, const std::string& filename) {
+  std::vector<struct iovec> rest(iov, iov + count);
+  std::size_t next = 0;
+  off_t position = offset;
+  while (next < rest.size()) {
+    const int batch =
+        static_cast<int>(std::min<std::size_t>(rest.size() - next, IOV_MAX));
+    const ssize_t n = ::pwritev(fd, &rest[next], batch, position);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename, "write", errno);
+    }
+    position += n;
+    std::size_t done = n;
+    while (next < rest.size() && done >= rest[next].iov_len) {
+      done -= rest[next].iov_len;
+      ++next;
+    }
+    if (done > 0) {
+      rest[next].iov_base = static_cast<char*>(rest[next].iov_base) + done;
+      rest[next].iov_len -= done;
+    }
+  }
+}
+
+bool punchHole(const int fd, const off_t offset, const std::size_t length,
+               const std::string& filename) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+  for (;;) {
+    if (::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+                    length) == 0) {
+      return true;
+    }
+    if (errno == EOPNOTSUPP || errno == ENOSYS) {
+      break;
+    }
+    if (errno != EINTR) {
+      throw FileIOException(filename, "hole punch", errno);
+    }
+  }
+#endif
+  const std::vector<char> zeroes(length, 0);
+  pwriteFully(fd, &zeroes[0], length, offset, filename);
+  return false;
+}
+
+void Storage::readv(const struct iovec* iov, const int count,
+                    const off_t offset) {
+  off_t position = offset;
+  for (int i = 0; i < count; ++i) {
+    read(iov[i].iov_base, iov[i].iov_len, position);
+    position += iov[i].iov_len;
+  }
+}
+
+void Storage::writev(const struct iovec* iov, const int count,
+                     const off_t offset) {
+  off_t position = offset;
+  for (int i = 0; i < count; ++i) {
+    write(iov[i].iov_base, iov[i].iov_len, position);
+    position += iov[i].iov_len;
+  }
+}
+
+void Storage::discard(const off_t offset, const std::size_t length) {
+  const std::vector<char> zeroes(length, 0);
+  write(&zeroes[0], length, offset);
+}
+
+PosixStorage* PosixStorage::open(const std::string& filename,
+                                 const bool create_new) {
+  int flags = O_RDWR | O_CLOEXEC;
+  if (create_new) {
+    flags |= O_CREAT | O_EXCL;
+  }
+  int fd;
+  do {
+    fd = ::open(filename.c_str(), flags, 0666);
+  } while (fd < 0 && errno == EINTR);
+  if (fd < 0) {
+    if (errno == EEXIST) {
+      throw FileExistsException(filename);
+    }
+    if (errno == ENOENT) {
+      throw FileNotFoundException(filename);
+    }
+    throw FileIOException(filename, "open", errno);
+  }
+  return new PosixStorage(filename, fd);
+}
+
+void PosixStorage::remove(const std::string& filename) {
+  if (::unlink(filename.c_str()) != 0) {
+    if (errno == ENOENT) {
+      throw FileNotFoundException(filename);
+    }
+    throw FileIOException(filename, "remove", errno);
+  }
+}
+
+PosixStorage::~PosixStorage() {
+  ::close(fd_);
+}
+
+void PosixStorage::read(void* buffer, const std::size_t length,
+                        const off_t offset) {
+  preadFully(fd_, buffer, length, offset, filename_);
+}
+
+void PosixStorage::write(const void* buffer, const std::size_t length,
+                         const off_t offset) {
+  pwriteFully(fd_, buffer, length, offset, filename_);
+}
+
+void PosixStorage::readv(const struct iovec* iov, const int count,
+                         const off_t offset) {
+  preadvFully(fd_, iov, count, offset, filename_);
+}
+
+void PosixStorage::writev(const struct iovec* iov, const int count,
+                          const off_t offset) {
+  pwritevFully(fd_, iov, count, offset, filename_);
+}
+
+void PosixStorage::discard(const off_t offset, const std::size_t length) {
+  punchHole(fd_, offset, length, filename_);
+}
+
+void PosixStorage::truncate(const off_t length) {
+  while (::ftruncate(fd_, length) != 0) {
+    if (errno != EINTR) {
+      throw FileIOException(filename_, "truncate", errno);
+    }
+  }
+}
+
+}
@@ -0,0 +1,215 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <string>
+
+namespace badgerdb {
+
+/**
+ * @brief Byte-addressed backing store of one database file.
+ *
+ * A File sees its contents as a flat array of bytes; a Storage decides where
+ * those bytes live.  PosixStorage keeps them in an OS file of their own;
+ * other implementations place them inside shared or split OS files.
+ * Implementations must allow concurrent calls on disjoint byte ranges.
+ */
+class Storage {
+ public:
+  virtual ~Storage() {}
+
+  /**
+   * Reads <length> bytes at <offset>.  Bytes that were never written read as
+   * zero.
+   *
+   * @param buffer  Destination of the data.
+   * @param length  Number of bytes to read.
+   * @param offset  Position to read from.
+   * @throws  FileIOException   If the read fails.
+   */
+  virtual void read(void* buffer, const std::size_t length,
+                    const off_t offset) = 0;
+
+  /**
+   * Writes <length> bytes at <offset>, growing the store if needed.
+   *
+   * @param buffer  Data to write.
+   * @param length  Number of bytes to write.
+   * @param offset  Position to write to.
+   * @throws  FileIOException   If the write fails.
+   */
+  virtual void write(const void* buffer, const std::size_t length,
+                     const off_t offset) = 0;
+
+  /**
+   * Reads consecutive bytes starting at <offset> into <count> buffers, in
+   * order.  Bytes that were never written read as zero.  The default reads
+   * each buffer separately.
+   *
+   * @param iov     Destination buffers.
+   * @param count   Number of buffers.
+   * @param offset  Position to read from.
+   * @throws  FileIOException   If the read fails.
+   */
+  virtual void readv(const struct iovec* iov, const int count,
+                     const off_t offset);
+
+  /**
+   * Writes <count> buffers, in order, to consecutive bytes starting at
+   * <offset>.  The default writes each buffer separately.
+   *
+   * @param iov     Data to write.
+   * @param count   Number of buffers.
+   * @param offset  Position to write to.
+   * @throws  FileIOException   If the write fails.
+   */
+  virtual void writev(const struct iovec* iov, const int count,
+                      const off_t offset);
+
+  /**
+   * Discards the bytes at and past <length>, returning their space; they
+   * read as zero afterwards.
+   *
+   * @param length  New size of the store.
+   * @throws  FileIOException   If the store could not be shrunk.
+   */
+  virtual void truncate(const off_t length) = 0;
+
+  /**
+   * Gives back the space of <length> bytes at <offset> without changing the
+   * size of the store; they read as zero afterwards.  The default writes
+   * zeroes, which keeps the space.
+   *
+   * @param offset  Position of the bytes.
+   * @param length  Number of bytes.
+   * @throws  FileIOException   If the bytes could not be discarded.
+   */
+  virtual void discard(const off_t offset, const std::size_t length);
+};
+
+/**
+ * @brief Storage in an OS file of its own, accessed with pread/pwrite.
+ */
+class PosixStorage : public Storage {
+ public:
+  /**
+   * Opens or creates the named OS file.
+   *
+   * @param filename    Name of the file; must outlive the storage.
+   * @param create_new  Whether to create a new file.
+   * @throws  FileExistsException     If create_new is set and the file
+   *                                  already exists.
+   * @throws  FileNotFoundException   If create_new is not set and the file
+   *                                  doesn't exist.
+   * @throws  FileIOException         If the operating system refuses to open
+   *                                  the file.
+   */
+  static PosixStorage* open(const std::string& filename,
+                            const bool create_new);
+
+  /**
+   * Deletes the named OS file.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileIOException         If the file could not be deleted.
+   */
+  static void remove(const std::string& filename);
+
+  /**
+   * Closes the file.
+   */
+  ~PosixStorage();
+
+  void read(void* buffer, const std::size_t length, const off_t offset);
+
+  void write(const void* buffer, const std::size_t length,
+             const off_t offset);
+
+  void readv(const struct iovec* iov, const int count, const off_t offset);
+
+  void writev(const struct iovec* iov, const int count, const off_t offset);
+
+  void truncate(const off_t length);
+
+  void discard(const off_t offset, const std::size_t length);
+
+  /**
+   * Returns the file descriptor.
+   */
+  int fd() const { return fd_; }
+
+ private:
+  PosixStorage(const std::string& filename, const int fd)
+      : filename_(filename), fd_(fd) {}
+
+  /**
+   * Name of the file, for error messages.
+   */
+  const std::string& filename_;
+
+  /**
+   * Descriptor of the open file.
+   */
+  const int fd_;
+};
+
+/**
+ * Reads <length> bytes at <offset> of a descriptor with pread, retrying
+ * interrupted and short reads.  Bytes past the end of the file read as zero.
+ *
+ * @throws  FileIOException   If the read fails; <filename> names the file.
+ */
+void preadFully(const int fd, void* buffer, const std::size_t length,
+                const off_t offset, const std::string& filename);
+
+/**
+ * Reads consecutive bytes at <offset> of a descriptor into <count> buffers
+ * with preadv, retrying interrupted and short reads.  Bytes past the end of
+ * the file read as zero.
+ *
+ * @throws  FileIOException   If the read fails; <filename> names the file.
+ */
+void preadvFully(const int fd, const struct iovec* iov, const int count,
+                 const off_t offset, const std::string& filename);
+
+/**
+ * Writes <length> bytes at <offset> of a descriptor with pwrite, retrying
+ * interrupted and short writes.
+ *
+ * @throws  FileIOException   If the write fails; <filename> names the file.
+ */
+void pwriteFully(const int fd, const void* buffer, const std::size_t length,
+                 const off_t offset, const std::string& filename);
+
+/**
+ * Writes <count> buffers to consecutive bytes at <offset> of a descriptor
+ * with pwritev, retrying interrupted and short writes.
+ *
+ * @throws  FileIOException   If the write fails; <filename> names the file.
+ */
+void pwritevFully(const int fd, const struct iovec* iov, const int count,
+                  const off_t offset, const std::string& filename);
+
+/**
+ * Punches a hole of <length> bytes at <offset> of a descriptor, returning
+ * their space to the filesystem; they read as zero afterwards.  Falls back to
+ * writing zeroes where the filesystem cannot punch holes.
+ *
+ * @return  True if the space was returned, false if zeroes were written.
+ * @throws  FileIOException   If the hole could not be made; <filename> names
+ *                            the file.
+ */
+bool punchHole(const int fd, const off_t offset, const std::size_t length,
+               const std::string& filename);
+
+}
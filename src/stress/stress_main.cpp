@@ -0,0 +1,576 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * @file
+ * @brief Randomized multi-threaded stress test for BufMgr.
+ *
+ * Worker threads share one buffer pool and a handful of files and issue a
+ * random mix of allocPage, readPage, unPinPage, disposePage and flushFile.
+ * Every page carries a record naming its file, page number, owning worker
+ * and a version; only the owner updates or disposes a page, other workers
+ * read it and check that it is still a page of the right file.  At the end
+ * all pins must have been released (every file flushes cleanly) and every
+ * surviving page must hold exactly the version its owner last wrote, both
+ * through the pool and straight from disk.
+ *
+ * Each worker draws its operations from its own generator seeded with
+ * seed + worker number, so with --ops the operation streams are fixed by the
+ * seed.  --serial additionally runs the workers round-robin on one thread,
+ * which makes the whole run, including the interleaving, reproducible:
+ * <pre>
+ *   badgerdb_stress --seed=1234 --threads=8 --ops=20000 --serial
+ * </pre>
+ *
+ * --writer runs the pool's background writer alongside the workers.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "file_iterator.h"
+#include "page.h"
+#include "page_iterator.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+namespace badgerdb {
+namespace stress {
+
+namespace {
+
+/**
+ * @brief Command line configuration.
+ */
+struct Config {
+  std::uint64_t seed;
+  int threads;
+  int files;
+  std::uint32_t frames;
+  std::uint64_t ops;
+  double duration;
+  bool serial;
+  bool verbose;
+  bool writer;
+
+  Config()
+      : seed(0),
+        threads(4),
+        files(3),
+        frames(64),
+        ops(0),
+        duration(2),
+        serial(false),
+        verbose(false),
+        writer(false) {}
+};
+
+const std::size_t RECORD_SIZE = 96;
+
+std::uint64_t g_seed;
+
+void fail(const std::string& what) {
+  std::cerr << "FAILED: " << what << "\n"
+            << "reproduce with --seed=" << g_seed << "\n";
+  std::abort();
+}
+
+/**
+ * Returns the record stored on a page: identity, owner and version, padded
+ * with filler derived from them so any torn or misplaced write is caught.
+ */
+std::string makeRecord(const int file_no, const PageId page_no,
+                       const int owner, const std::uint32_t version) {
+  char head[64];
+  std::snprintf(head, sizeof(head), "f=%02d p=%08u t=%03d v=%010u ", file_no,
+                page_no, owner, version);
+  std::string record(head);
+  while (record.size() < RECORD_SIZE) {
+    record += static_cast<char>('a' + (page_no + version + record.size()) % 26);
+  }
+  return record;
+}
+
+/**
+ * Returns the identity prefix ("f=.. p=........") of a page's record.
+ */
+std::string identity(const int file_no, const PageId page_no) {
+  return makeRecord(file_no, page_no, 0, 0).substr(0, 14);
+}
+
+/**
+ * @brief State shared by all workers.
+ */
+struct Shared {
+  Config config;
+  BufMgr* buf_mgr;
+  std::vector<File*> files;
+
+  /**
+   * Latches protecting page contents, striped by page number.  The buffer
+   * manager only protects frames, not what is in them.
+   */
+  std::mutex content_latches[256];
+
+  /**
+   * Pages published for other workers to read: (file, page) pairs.
+   */
+  std::mutex published_latch;
+  std::vector<std::pair<int, PageId> > published;
+
+  std::mutex& contentLatch(const int file_no, const PageId page_no) {
+    return content_latches[(page_no * 7 + file_no) % 256];
+  }
+};
+
+/**
+ * @brief A page owned by a worker, with the last version it wrote.
+ */
+struct OwnedPage {
+  int file_no;
+  PageId page_no;
+  std::uint32_t version;
+};
+
+/**
+ * @brief One stream of random operations.
+ */
+class Worker {
+ public:
+  enum Op { ALLOC, READ_OWN, UPDATE_OWN, READ_OTHER, PIN_TWICE, DISPOSE, FLUSH,
+            NUM_OPS };
+
+  Worker(Shared& shared, const int id)
+      : shared_(shared), id_(id), rng_(shared.config.seed + id) {
+    for (int i = 0; i < NUM_OPS; ++i) {
+      counts_[i] = 0;
+    }
+    expected_failures_ = 0;
+  }
+
+  void step() {
+    const unsigned p = rng_() % 100;
+    Op op;
+    if (owned_.empty() || p < 15) {
+      op = ALLOC;
+    } else if (p < 40) {
+      op = READ_OWN;
+    } else if (p < 60) {
+      op = UPDATE_OWN;
+    } else if (p < 80) {
+      op = READ_OTHER;
+    } else if (p < 88) {
+      op = PIN_TWICE;
+    } else if (p < 97) {
+      op = DISPOSE;
+    } else {
+      op = FLUSH;
+    }
+    try {
+      switch (op) {
+        case ALLOC: alloc(); break;
+        case READ_OWN: readOwn(); break;
+        case UPDATE_OWN: updateOwn(); break;
+        case READ_OTHER: readOther(); break;
+        case PIN_TWICE: pinTwice(); break;
+        case DISPOSE: dispose(); break;
+        default: flush(); break;
+      }
+      ++counts_[op];
+    } catch (const BufferExceededException&) {
+      // Every frame is pinned by other workers right now.
+      ++expected_failures_;
+    } catch (const PagePinnedException&) {
+      // Flush or dispose raced with another worker's pin.
+      ++expected_failures_;
+    }
+  }
+
+  const std::vector<OwnedPage>& owned() const { return owned_; }
+
+  std::uint64_t count(const int op) const { return counts_[op]; }
+
+  std::uint64_t expectedFailures() const { return expected_failures_; }
+
+ private:
+  File* file(const int file_no) { return shared_.files[file_no]; }
+
+  OwnedPage& pickOwned() { return owned_[rng_() % owned_.size()]; }
+
+  void alloc() {
+    const int file_no = rng_() % shared_.files.size();
+    PageId page_no;
+    Page* page;
+    shared_.buf_mgr->allocPage(file(file_no), page_no, page);
+    {
+      std::lock_guard<std::mutex> guard(shared_.contentLatch(file_no, page_no));
+      if (page->begin() != page->end()) {
+        fail("newly allocated page is not empty");
+      }
+      page->insertRecord(makeRecord(file_no, page_no, id_, 0));
+    }
+    shared_.buf_mgr->unPinPage(file(file_no), page_no, true);
+    const OwnedPage owned = {file_no, page_no, 0};
+    owned_.push_back(owned);
+    std::lock_guard<std::mutex> guard(shared_.published_latch);
+    shared_.published.push_back(std::make_pair(file_no, page_no));
+  }
+
+  void verifyOwn(Page* page, const OwnedPage& owned) {
+    const RecordId rid = {owned.page_no, 1};
+    const std::string expected =
+        makeRecord(owned.file_no, owned.page_no, id_, owned.version);
+    const std::string actual = page->getRecord(rid);
+    if (actual != expected) {
+      fail("page contents mismatch: expected '" + expected + "' got '" +
+           actual + "'");
+    }
+  }
+
+  void readOwn() {
+    const OwnedPage& owned = pickOwned();
+    Page* page;
+    shared_.buf_mgr->readPage(file(owned.file_no), owned.page_no, page);
+    {
+      std::lock_guard<std::mutex> guard(
+          shared_.contentLatch(owned.file_no, owned.page_no));
+      verifyOwn(page, owned);
+    }
+    shared_.buf_mgr->unPinPage(file(owned.file_no), owned.page_no, false);
+  }
+
+  void updateOwn() {
+    OwnedPage& owned = pickOwned();
+    Page* page;
+    shared_.buf_mgr->readPage(file(owned.file_no), owned.page_no, page);
+    {
+      std::lock_guard<std::mutex> guard(
+          shared_.contentLatch(owned.file_no, owned.page_no));
+      verifyOwn(page, owned);
+      const RecordId rid = {owned.page_no, 1};
+      page->updateRecord(rid, makeRecord(owned.file_no, owned.page_no, id_,
+                                         owned.version + 1));
+    }
+    ++owned.version;
+    shared_.buf_mgr->unPinPage(file(owned.file_no), owned.page_no, true);
+  }
+
+  void readOther() {
+    std::pair<int, PageId> target;
+    {
+      std::lock_guard<std::mutex> guard(shared_.published_latch);
+      if (shared_.published.empty()) {
+        return;
+      }
+      target = shared_.published[rng_() % shared_.published.size()];
+    }
+    Page* page;
+    try {
+      shared_.buf_mgr->readPage(file(target.first), target.second, page);
+    } catch (const InvalidPageException&) {
+      // Disposed by its owner since it was published.
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> guard(
+          shared_.contentLatch(target.first, target.second));
+      // The page may have been disposed and reallocated by another worker,
+      // but it must still be that page of that file.
+      for (PageIterator it = page->begin(); it != page->end(); ++it) {
+        if ((*it).compare(0, 14, identity(target.first, target.second)) != 0) {
+          fail("page " + identity(target.first, target.second) +
+               " holds record '" + *it + "'");
+        }
+      }
+    }
+    shared_.buf_mgr->unPinPage(file(target.first), target.second, false);
+  }
+
+  void pinTwice() {
+    const OwnedPage& owned = pickOwned();
+    Page* first;
+    Page* second;
+    shared_.buf_mgr->readPage(file(owned.file_no), owned.page_no, first);
+    try {
+      shared_.buf_mgr->readPage(file(owned.file_no), owned.page_no, second);
+    } catch (...) {
+      shared_.buf_mgr->unPinPage(file(owned.file_no), owned.page_no, false);
+      throw;
+    }
+    if (first != second) {
+      fail("page pinned twice is in two frames");
+    }
+    shared_.buf_mgr->unPinPage(file(owned.file_no), owned.page_no, false);
+    shared_.buf_mgr->unPinPage(file(owned.file_no), owned.page_no, false);
+  }
+
+  void dispose() {
+    const std::size_t victim = rng_() % owned_.size();
+    const OwnedPage owned = owned_[victim];
+    {
+      // Hold the content latch so no reader of this page is between its
+      // readPage and its check while the page is going away.
+      std::lock_guard<std::mutex> guard(
+          shared_.contentLatch(owned.file_no, owned.page_no));
+      shared_.buf_mgr->disposePage(file(owned.file_no), owned.page_no);
+    }
+    owned_[victim] = owned_.back();
+    owned_.pop_back();
+  }
+
+  void flush() {
+    shared_.buf_mgr->flushFile(file(rng_() % shared_.files.size()));
+  }
+
+  Shared& shared_;
+  int id_;
+  std::mt19937_64 rng_;
+  std::vector<OwnedPage> owned_;
+  std::uint64_t counts_[NUM_OPS];
+  std::uint64_t expected_failures_;
+};
+
+bool parseArgs(int argc, char** argv, Config& config) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--serial") {
+      config.serial = true;
+      continue;
+    }
+    if (arg == "--verbose") {
+      config.verbose = true;
+      continue;
+    }
+    if (arg == "--writer") {
+      config.writer = true;
+      continue;
+    }
+    const std::size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      return false;
+    }
+    const std::string key = arg.substr(2, eq - 2);
+    const char* value = arg.c_str() + eq + 1;
+    if (key == "seed") {
+      config.seed = std::strtoull(value, NULL, 10);
+    } else if (key == "threads") {
+      config.threads = std::atoi(value);
+    } else if (key == "files") {
+      config.files = std::atoi(value);
+    } else if (key == "frames") {
+      config.frames = std::strtoul(value, NULL, 10);
+    } else if (key == "ops") {
+      config.ops = std::strtoull(value, NULL, 10);
+    } else if (key == "duration") {
+      config.duration = std::atof(value);
+    } else {
+      return false;
+    }
+  }
+  return config.threads > 0 && config.files > 0 && config.frames > 0;
+}
+
+void removeIfExists(const std::string& filename) {
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException&) {
+  }
+}
+
+std::string fileName(const int file_no) {
+  std::stringstream ss;
+  ss << "stress." << file_no;
+  return ss.str();
+}
+
+/**
+ * Checks the end state: no pins left, and every owned page (and nothing
+ * else) present with its final contents.
+ */
+void verify(Shared& shared, const std::vector<std::unique_ptr<Worker> >&
+                                workers) {
+  for (std::size_t f = 0; f < shared.files.size(); ++f) {
+    try {
+      shared.buf_mgr->flushFile(shared.files[f]);
+    } catch (const PagePinnedException& e) {
+      fail("pin leaked: " + e.message());
+    }
+  }
+
+  std::vector<std::size_t> owned_per_file(shared.files.size(), 0);
+  for (std::size_t w = 0; w < workers.size(); ++w) {
+    const std::vector<OwnedPage>& owned = workers[w]->owned();
+    for (std::size_t i = 0; i < owned.size(); ++i) {
+      const std::string expected = makeRecord(owned[i].file_no,
+                                              owned[i].page_no, w,
+                                              owned[i].version);
+      const RecordId rid = {owned[i].page_no, 1};
+      // From disk, as written back by flushFile ...
+      const Page on_disk =
+          shared.files[owned[i].file_no]->readPage(owned[i].page_no);
+      if (on_disk.getRecord(rid) != expected) {
+        fail("on disk: expected '" + expected + "' got '" +
+             on_disk.getRecord(rid) + "'");
+      }
+      // ... and through the pool.
+      Page* page;
+      shared.buf_mgr->readPage(shared.files[owned[i].file_no],
+                               owned[i].page_no, page);
+      if (page->getRecord(rid) != expected) {
+        fail("in pool: expected '" + expected + "' got '" +
+             page->getRecord(rid) + "'");
+      }
+      shared.buf_mgr->unPinPage(shared.files[owned[i].file_no],
+                                owned[i].page_no, false);
+      ++owned_per_file[owned[i].file_no];
+    }
+  }
+
+  for (std::size_t f = 0; f < shared.files.size(); ++f) {
+    std::size_t used = 0;
+    for (FileIterator it = shared.files[f]->begin();
+         it != shared.files[f]->end(); ++it) {
+      ++used;
+    }
+    if (used != owned_per_file[f]) {
+      std::stringstream ss;
+      ss << fileName(f) << " has " << used << " used pages, workers own "
+         << owned_per_file[f];
+      fail(ss.str());
+    }
+  }
+}
+
+}
+
+int run(int argc, char** argv) {
+  Config config;
+  if (!parseArgs(argc, argv, config)) {
+    std::cerr << "usage: " << argv[0]
+              << " [--seed=N] [--threads=N] [--files=N] [--frames=N]"
+                 " [--ops=N | --duration=SECONDS] [--serial] [--writer]"
+                 " [--verbose]\n";
+    return 1;
+  }
+  if (config.seed == 0) {
+    config.seed = std::chrono::steady_clock::now().time_since_epoch().count() %
+                  1000000007;
+  }
+  g_seed = config.seed;
+  std::cout << "seed=" << config.seed << " threads=" << config.threads
+            << " files=" << config.files << " frames=" << config.frames
+            << (config.serial ? " serial" : "")
+            << (config.writer ? " writer" : "") << "\n";
+
+  std::vector<std::unique_ptr<File> > files;
+  for (int f = 0; f < config.files; ++f) {
+    removeIfExists(fileName(f));
+    files.push_back(std::unique_ptr<File>(new File(File::create(fileName(f)))));
+  }
+
+  {
+    Shared shared;
+    shared.config = config;
+    for (std::size_t f = 0; f < files.size(); ++f) {
+      shared.files.push_back(files[f].get());
+    }
+    BufMgr buf_mgr(config.frames);
+    if (config.writer) {
+      buf_mgr.startBackgroundWriter();
+    }
+    shared.buf_mgr = &buf_mgr;
+
+    std::vector<std::unique_ptr<Worker> > workers;
+    for (int t = 0; t < config.threads; ++t) {
+      workers.push_back(std::unique_ptr<Worker>(new Worker(shared, t)));
+    }
+
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(config.duration));
+    if (config.serial) {
+      for (std::uint64_t i = 0;
+           config.ops > 0 ? i < config.ops :
+               std::chrono::steady_clock::now() < deadline;
+           ++i) {
+        for (std::size_t t = 0; t < workers.size(); ++t) {
+          workers[t]->step();
+        }
+      }
+    } else {
+      std::vector<std::thread> threads;
+      for (std::size_t t = 0; t < workers.size(); ++t) {
+        Worker* worker = workers[t].get();
+        threads.push_back(std::thread([worker, &config, deadline]() {
+          for (std::uint64_t i = 0;
+               config.ops > 0 ? i < config.ops :
+                   std::chrono::steady_clock::now() < deadline;
+               ++i) {
+            worker->step();
+          }
+        }));
+      }
+      for (std::size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+      }
+    }
+
+    verify(shared, workers);
+
+    std::uint64_t totals[Worker::NUM_OPS] = {0};
+    std::uint64_t expected_failures = 0;
+    for (std::size_t t = 0; t < workers.size(); ++t) {
+      for (int op = 0; op < Worker::NUM_OPS; ++op) {
+        totals[op] += workers[t]->count(op);
+      }
+      expected_failures += workers[t]->expectedFailures();
+    }
+    std::cout << "alloc=" << totals[Worker::ALLOC]
+              << " read_own=" << totals[Worker::READ_OWN]
+              << " update_own=" << totals[Worker::UPDATE_OWN]
+              << " read_other=" << totals[Worker::READ_OTHER]
+              << " pin_twice=" << totals[Worker::PIN_TWICE]
+              << " dispose=" << totals[Worker::DISPOSE]
+              << " flush=" << totals[Worker::FLUSH]
+              << " busy=" << expected_failures << "\n";
+    if (config.verbose) {
+      buf_mgr.printSelf();
+    }
+  }
+
+  files.clear();
+  for (int f = 0; f < config.files; ++f) {
+    removeIfExists(fileName(f));
+  }
+  std::cout << "Passed stress test.\n";
+  return 0;
+}
+
+}
+}
+
+int main(int argc, char** argv) {
+  return badgerdb::stress::run(argc, argv);
+}
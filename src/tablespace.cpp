@@ -0,0 +1,535 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "tablespace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#include "exceptions/file_exists_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/tablespace_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+const char MAGIC[8] = {'B', 'D', 'B', 'T', 'S', 'P', 'C', '\0'};
+
+/**
+ * Open tablespaces by path, so that opening one twice shares the directory.
+ * An entry is erased when its tablespace is destroyed.  Never destroyed
+ * itself, since tablespaces with static storage duration may go after it.
+ */
+std::mutex open_tablespaces_latch;
+std::map<std::string, std::weak_ptr<Tablespace> >& open_tablespaces =
+    *new std::map<std::string, std::weak_ptr<Tablespace> >();
+
+}
+
+/**
+ * @brief Storage of a logical file in a tablespace.
+ */
+class SegmentStorage : public Storage {
+ public:
+  SegmentStorage(const std::shared_ptr<Tablespace>& tablespace,
+                 const std::uint32_t slot)
+      : tablespace_(tablespace), slot_(slot) {}
+
+  void read(void* buffer, const std::size_t length, const off_t offset) {
+    tablespace_->read(slot_, buffer, length, offset);
+  }
+
+  void write(const void* buffer, const std::size_t length,
+             const off_t offset) {
+    tablespace_->write(slot_, buffer, length, offset);
+  }
+
+  void readv(const struct iovec* iov, const int count, const off_t offset) {
+    tablespace_->readv(slot_, iov, count, offset);
+  }
+
+  void writev(const struct iovec* iov, const int count, const off_t offset) {
+    tablespace_->writev(slot_, iov, count, offset);
+  }
+
+  void truncate(const off_t length) {
+    tablespace_->truncate(slot_, length);
+  }
+
+  void discard(const off_t offset, const std::size_t length) {
+    tablespace_->discard(slot_, offset, length);
+  }
+
+ private:
+  /**
+   * Keeps the tablespace open while any of its files is.
+   */
+  const std::shared_ptr<Tablespace> tablespace_;
+
+  const std::uint32_t slot_;
+};
+
+std::shared_ptr<Tablespace> Tablespace::create(
+    const std::string& path, const std::uint32_t extent_pages) {
+  // Declared before the guard: if formatting fails, the destructor runs
+  // after the latch is released, since it takes the latch itself.
+  std::shared_ptr<Tablespace> tablespace;
+  std::lock_guard<std::mutex> guard(open_tablespaces_latch);
+  tablespace.reset(
+      new Tablespace(FileRegistry::instance().acquire(path, true)));
+  tablespace->format(extent_pages > 0 ? extent_pages : 1);
+  open_tablespaces[path] = tablespace;
+  return tablespace;
+}
+
+std::shared_ptr<Tablespace> Tablespace::open(const std::string& path) {
+  std::shared_ptr<Tablespace> tablespace;
+  std::lock_guard<std::mutex> guard(open_tablespaces_latch);
+  std::map<std::string, std::weak_ptr<Tablespace> >::iterator it =
+      open_tablespaces.find(path);
+  if (it != open_tablespaces.end()) {
+    tablespace = it->second.lock();
+  }
+  if (!tablespace) {
+    tablespace.reset(
+        new Tablespace(FileRegistry::instance().acquire(path, false)));
+    tablespace->load();
+    open_tablespaces[path] = tablespace;
+  }
+  return tablespace;
+}
+
+Tablespace::Tablespace(FileRegistry::Entry* file) : file_(file) {
+  std::memset(&header_, 0, sizeof(header_));
+}
+
+Tablespace::~Tablespace() {
+  {
+    // The entry may already belong to a tablespace opened again since our
+    // last reference went away; leave that one.
+    std::lock_guard<std::mutex> guard(open_tablespaces_latch);
+    std::map<std::string, std::weak_ptr<Tablespace> >::iterator it =
+        open_tablespaces.find(path());
+    if (it != open_tablespaces.end() && it->second.expired()) {
+      open_tablespaces.erase(it);
+    }
+  }
+  FileRegistry::instance().release(file_);
+}
+
+void Tablespace::format(const std::uint32_t extent_pages) {
+  std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+  header_.version = VERSION;
+  header_.extent_size = extent_pages * Page::SIZE;
+  header_.max_segments = MAX_SEGMENTS;
+  header_.max_extents =
+      (METADATA_SIZE - ownerOffset(0)) / sizeof(ExtentOwner);
+  header_.num_extents = 0;
+
+  slots_.assign(MAX_SEGMENTS, Slot());
+  std::memset(&slots_[0], 0, slots_.size() * sizeof(Slot));
+  extents_.assign(MAX_SEGMENTS, std::vector<std::uint32_t>());
+
+  // Write the whole metadata area so that the directory reads back as
+  // zeroes.
+  std::vector<char> metadata(METADATA_SIZE, 0);
+  std::memcpy(&metadata[0], &header_, sizeof(header_));
+  file_->storage->write(&metadata[0], metadata.size(), 0);
+}
+
+void Tablespace::load() {
+  file_->storage->read(&header_, sizeof(header_), 0);
+  if (std::memcmp(header_.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw TablespaceException(path(), "not a tablespace");
+  }
+  if (header_.version != VERSION || header_.max_segments != MAX_SEGMENTS ||
+      header_.extent_size == 0 || header_.extent_size % Page::SIZE != 0) {
+    throw TablespaceException(path(), "unsupported format");
+  }
+
+  slots_.resize(MAX_SEGMENTS);
+  file_->storage->read(&slots_[0], slots_.size() * sizeof(Slot),
+                       slotOffset(0));
+  extents_.assign(MAX_SEGMENTS, std::vector<std::uint32_t>());
+  for (std::uint32_t slot = 0; slot < MAX_SEGMENTS; ++slot) {
+    if (slots_[slot].used) {
+      slots_[slot].name[MAX_NAME_LENGTH] = '\0';
+      names_[slots_[slot].name] = slot;
+    }
+  }
+
+  std::vector<ExtentOwner> owners(header_.num_extents);
+  if (!owners.empty()) {
+    file_->storage->read(&owners[0], owners.size() * sizeof(ExtentOwner),
+                         ownerOffset(0));
+  }
+  for (std::uint32_t extent = 0; extent < owners.size(); ++extent) {
+    const ExtentOwner& owner = owners[extent];
+    if (owner.slot == 0 || owner.slot > MAX_SEGMENTS ||
+        !slots_[owner.slot - 1].used) {
+      free_extents_.push_back(extent);
+      continue;
+    }
+    std::vector<std::uint32_t>& list = extents_[owner.slot - 1];
+    if (list.size() <= owner.index) {
+      list.resize(owner.index + 1, header_.max_extents);
+    }
+    list[owner.index] = extent;
+  }
+  for (std::uint32_t slot = 0; slot < MAX_SEGMENTS; ++slot) {
+    const std::vector<std::uint32_t>& list = extents_[slot];
+    if (std::find(list.begin(), list.end(), header_.max_extents) !=
+        list.end()) {
+      std::stringstream ss;
+      ss << "segment " << slots_[slot].name << " is missing an extent";
+      throw TablespaceException(path(), ss.str());
+    }
+  }
+  // Reuse low extents first.
+  std::sort(free_extents_.rbegin(), free_extents_.rend());
+}
+
+File Tablespace::createFile(const std::string& name) {
+  if (name.empty() || name.size() > MAX_NAME_LENGTH) {
+    throw TablespaceException(path(), "invalid file name '" + name + "'");
+  }
+  std::shared_ptr<Tablespace> self = shared_from_this();
+  FileRegistry::Entry* entry = FileRegistry::instance().acquire(
+      qualifiedName(name), true,
+      [self, name](const std::string& qualified, const bool create_new) {
+        return self->openSegment(name, qualified, create_new);
+      });
+  File file(entry);
+  file.writeNewHeader();
+  return file;
+}
+
+File Tablespace::openFile(const std::string& name) {
+  std::shared_ptr<Tablespace> self = shared_from_this();
+  File file(FileRegistry::instance().acquire(
+      qualifiedName(name), false,
+      [self, name](const std::string& qualified, const bool create_new) {
+        return self->openSegment(name, qualified, create_new);
+      }));
+  file.checkFormat();
+  return file;
+}
+
+void Tablespace::removeFile(const std::string& name) {
+  FileRegistry::instance().remove(
+      qualifiedName(name), [this, &name](const std::string& qualified) {
+        removeSegment(name, qualified);
+      });
+}
+
+bool Tablespace::exists(const std::string& name) const {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  return names_.find(name) != names_.end();
+}
+
+std::vector<std::string> Tablespace::files() const {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  std::vector<std::string> names;
+  for (std::unordered_map<std::string, std::uint32_t>::const_iterator it =
+           names_.begin();
+       it != names_.end(); ++it) {
+    names.push_back(it->first);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+std::uint32_t Tablespace::numExtents() const {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  return header_.num_extents;
+}
+
+std::uint32_t Tablespace::freeExtents() const {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  return free_extents_.size();
+}
+
+Storage* Tablespace::openSegment(const std::string& name,
+                                 const std::string& qualified,
+                                 const bool create_new) {
+  std::unique_lock<std::shared_mutex> guard(latch_);
+  std::unordered_map<std::string, std::uint32_t>::const_iterator it =
+      names_.find(name);
+  if (!create_new) {
+    if (it == names_.end()) {
+      throw FileNotFoundException(qualified);
+    }
+    return new SegmentStorage(shared_from_this(), it->second);
+  }
+
+  if (it != names_.end()) {
+    throw FileExistsException(qualified);
+  }
+  std::uint32_t slot = 0;
+  while (slot < MAX_SEGMENTS && slots_[slot].used) {
+    ++slot;
+  }
+  if (slot == MAX_SEGMENTS) {
+    throw TablespaceException(path(), "directory is full");
+  }
+  std::memset(&slots_[slot], 0, sizeof(Slot));
+  std::strncpy(slots_[slot].name, name.c_str(), MAX_NAME_LENGTH);
+  slots_[slot].used = 1;
+  file_->storage->write(&slots_[slot], sizeof(Slot), slotOffset(slot));
+  names_[name] = slot;
+  extents_[slot].clear();
+  return new SegmentStorage(shared_from_this(), slot);
+}
+
+void Tablespace::removeSegment(const std::string& name,
+                               const std::string& qualified) {
+  std::unique_lock<std::shared_mutex> guard(latch_);
+  std::unordered_map<std::string, std::uint32_t>::iterator it =
+      names_.find(name);
+  if (it == names_.end()) {
+    throw FileNotFoundException(qualified);
+  }
+  const std::uint32_t slot = it->second;
+
+  // Release the extents before the slot, so a crash in between leaves
+  // an empty file rather than extents owned by a reused slot.
+  const ExtentOwner free_owner = {0, 0};
+  std::vector<std::uint32_t>& list = extents_[slot];
+  for (std::size_t i = 0; i < list.size(); ++i) {
+    file_->storage->write(&free_owner, sizeof(free_owner),
+                          ownerOffset(list[i]));
+    free_extents_.push_back(list[i]);
+  }
+  list.clear();
+  std::sort(free_extents_.rbegin(), free_extents_.rend());
+
+  std::memset(&slots_[slot], 0, sizeof(Slot));
+  file_->storage->write(&slots_[slot], sizeof(Slot), slotOffset(slot));
+  names_.erase(it);
+}
+
+void Tablespace::growSegment(const std::uint32_t slot,
+                             const std::uint32_t last_index) {
+  std::vector<std::uint32_t>& list = extents_[slot];
+  while (list.size() <= last_index) {
+    std::uint32_t extent;
+    if (!free_extents_.empty()) {
+      extent = free_extents_.back();
+      free_extents_.pop_back();
+      // A reused extent still holds the data of its previous owner.
+      const std::vector<char> zeroes(header_.extent_size, 0);
+      file_->storage->write(&zeroes[0], zeroes.size(), extentOffset(extent));
+    } else {
+      if (header_.num_extents == header_.max_extents) {
+        throw TablespaceException(path(), "no extents left");
+      }
+      extent = header_.num_extents++;
+      file_->storage->write(&header_, sizeof(header_), 0);
+    }
+    const ExtentOwner owner = {slot + 1,
+                               static_cast<std::uint32_t>(list.size())};
+    file_->storage->write(&owner, sizeof(owner), ownerOffset(extent));
+    list.push_back(extent);
+  }
+}
+
+void Tablespace::truncate(const std::uint32_t slot, const off_t length) {
+  std::unique_lock<std::shared_mutex> guard(latch_);
+  std::vector<std::uint32_t>& list = extents_[slot];
+  const std::uint32_t keep =
+      (length + header_.extent_size - 1) / header_.extent_size;
+  const off_t within = length % header_.extent_size;
+  if (within > 0 && keep <= list.size()) {
+    // The rest of the last extent kept must read as zero.
+    const std::vector<char> zeroes(header_.extent_size - within, 0);
+    file_->storage->write(&zeroes[0], zeroes.size(),
+                          extentOffset(list[keep - 1]) + within);
+  }
+  if (keep >= list.size()) {
+    return;
+  }
+  const ExtentOwner free_owner = {0, 0};
+  for (std::size_t i = keep; i < list.size(); ++i) {
+    file_->storage->write(&free_owner, sizeof(free_owner),
+                          ownerOffset(list[i]));
+    free_extents_.push_back(list[i]);
+  }
+  list.resize(keep);
+  std::sort(free_extents_.rbegin(), free_extents_.rend());
+}
+
+void Tablespace::mapRuns(
+    const std::vector<std::uint32_t>& list, const struct iovec* iov,
+    const int count, const off_t offset,
+    const std::function<void(const std::vector<struct iovec>&, const off_t)>&
+        run,
+    const std::function<void(void*, const std::size_t)>& hole) const {
+  std::vector<struct iovec> pieces;
+  off_t run_start = 0;
+  off_t run_end = 0;
+  off_t position = offset;
+  for (int i = 0; i < count; ++i) {
+    char* base = static_cast<char*>(iov[i].iov_base);
+    std::size_t done = 0;
+    while (done < iov[i].iov_len) {
+      const std::uint32_t index = position / header_.extent_size;
+      const off_t within = position % header_.extent_size;
+      const std::size_t piece = std::min<std::size_t>(
+          iov[i].iov_len - done, header_.extent_size - within);
+      if (index < list.size()) {
+        const off_t start = extentOffset(list[index]) + within;
+        if (!pieces.empty() && start != run_end) {
+          run(pieces, run_start);
+          pieces.clear();
+        }
+        if (pieces.empty()) {
+          run_start = start;
+        }
+        const struct iovec io = {base + done, piece};
+        pieces.push_back(io);
+        run_end = start + piece;
+      } else {
+        if (!pieces.empty()) {
+          run(pieces, run_start);
+          pieces.clear();
+        }
+        hole(base + done, piece);
+      }
+      done += piece;
+      position += piece;
+    }
+  }
+  if (!pieces.empty()) {
+    run(pieces, run_start);
+  }
+}
+
+void Tablespace::readv(const std::uint32_t slot, const struct iovec* iov,
+                       const int count, const off_t offset) const {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  Storage* storage = file_->storage.get();
+  mapRuns(extents_[slot], iov, count, offset,
+          [storage](const std::vector<struct iovec>& pieces,
+                    const off_t start) {
+            storage->readv(&pieces[0], static_cast<int>(pieces.size()),
+                           start);
+          },
+          [](void* dest, const std::size_t length) {
+            // Past the end of the segment.
+            std::memset(dest, 0, length);
+          });
+}
+
+void Tablespace::writev(const std::uint32_t slot, const struct iovec* iov,
+                        const int count, const off_t offset) {
+  std::size_t length = 0;
+  for (int i = 0; i < count; ++i) {
+    length += iov[i].iov_len;
+  }
+  if (length == 0) {
+    return;
+  }
+  const std::uint32_t last_index =
+      (offset + length - 1) / header_.extent_size;
+  std::shared_lock<std::shared_mutex> shared(latch_, std::defer_lock);
+  std::unique_lock<std::shared_mutex> exclusive(latch_, std::defer_lock);
+  shared.lock();
+  if (extents_[slot].size() <= last_index) {
+    shared.unlock();
+    exclusive.lock();
+    growSegment(slot, last_index);
+  }
+
+  Storage* storage = file_->storage.get();
+  mapRuns(extents_[slot], iov, count, offset,
+          [storage](const std::vector<struct iovec>& pieces,
+                    const off_t start) {
+            storage->writev(&pieces[0], static_cast<int>(pieces.size()),
+                            start);
+          },
+          [](void*, const std::size_t) {
+            // The segment was grown to cover the whole write.
+          });
+}
+
+void Tablespace::discard(const std::uint32_t slot, const off_t offset,
+                         const std::size_t length) {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  const std::vector<std::uint32_t>& list = extents_[slot];
+  std::size_t done = 0;
+  while (done < length) {
+    const off_t position = offset + done;
+    const std::uint32_t index = position / header_.extent_size;
+    const off_t within = position % header_.extent_size;
+    const std::size_t piece =
+        std::min<std::size_t>(length - done, header_.extent_size - within);
+    if (index < list.size()) {
+      file_->storage->discard(extentOffset(list[index]) + within, piece);
+    }
+    done += piece;
+  }
+}
+
+void Tablespace::read(const std::uint32_t slot, void* buffer,
+                      const std::size_t length, const off_t offset) const {
+  std::shared_lock<std::shared_mutex> guard(latch_);
+  const std::vector<std::uint32_t>& list = extents_[slot];
+  char* dest = static_cast<char*>(buffer);
+  std::size_t done = 0;
+  while (done < length) {
+    const off_t position = offset + done;
+    const std::uint32_t index = position / header_.extent_size;
+    const off_t within = position % header_.extent_size;
+    const std::size_t piece =
+        std::min<std::size_t>(length - done, header_.extent_size - within);
+    if (index < list.size()) {
+      file_->storage->read(dest + done, piece,
+                           extentOffset(list[index]) + within);
+    } else {
+      // Past the end of the segment.
+      std::memset(dest + done, 0, piece);
+    }
+    done += piece;
+  }
+}
+
+void Tablespace::write(const std::uint32_t slot, const void* buffer,
+                       const std::size_t length, const off_t offset) {
+  if (length == 0) {
+    return;
+  }
+  const std::uint32_t last_index =
+      (offset + length - 1) / header_.extent_size;
+  std::shared_lock<std::shared_mutex> shared(latch_, std::defer_lock);
+  std::unique_lock<std::shared_mutex> exclusive(latch_, std::defer_lock);
+  shared.lock();
+  if (extents_[slot].size() <= last_index) {
+    shared.unlock();
+    exclusive.lock();
+    growSegment(slot, last_index);
+  }
+
+  const std::vector<std::uint32_t>& list = extents_[slot];
+  const char* src = static_cast<const char*>(buffer);
+  std::size_t done = 0;
+  while (done < length) {
+    const off_t position = offset + done;
+    const std::uint32_t index = position / header_.extent_size;
+    const off_t within = position % header_.extent_size;
+    const std::size_t piece =
+        std::min<std::size_t>(length - done, header_.extent_size - within);
+    file_->storage->write(src + done, piece,
+                          extentOffset(list[index]) + within);
+    done += piece;
+  }
+}
+
+}
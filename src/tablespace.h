@@ -0,0 +1,345 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "file.h"
+#include "file_registry.h"
+
+namespace badgerdb {
+
+/**
+ * @brief One OS file holding many BadgerDB files as segments.
+ *
+ * Each logical file in a tablespace is a segment: a list of fixed-size
+ * extents of the tablespace file, allocated as the logical file grows.  A
+ * directory at the start of the OS file records every segment's name and the
+ * owner of every extent, so creating, opening and closing a logical file is
+ * a metadata operation that needs no file descriptor of its own.  All
+ * segments are read and written through the one descriptor of the
+ * tablespace.
+ *
+ * Files in a tablespace are ordinary File objects and work with BufMgr like
+ * any other file.  They are registered with the FileRegistry as
+ * "<tablespace path>::<name>".
+ *
+ * @code
+ *   std::shared_ptr<Tablespace> ts = Tablespace::create("data.ts");
+ *   File orders = ts->createFile("orders");
+ *   ...
+ *   ts->removeFile("orders");  // once no File object has it open
+ * @endcode
+ *
+ * Layout of the OS file: the first METADATA_SIZE bytes hold the header, the
+ * segment directory (MAX_SEGMENTS slots) and the extent owner table; extents
+ * follow.  Freed extents are reused before the file is extended.
+ */
+class Tablespace : public std::enable_shared_from_this<Tablespace> {
+ public:
+  /**
+   * Pages per extent unless another size is given to create().
+   */
+  static const std::uint32_t DEFAULT_EXTENT_PAGES = 16;
+
+  /**
+   * Number of logical files a tablespace can hold.
+   */
+  static const std::uint32_t MAX_SEGMENTS = 2048;
+
+  /**
+   * Longest name of a logical file.
+   */
+  static const std::size_t MAX_NAME_LENGTH = 55;
+
+  /**
+   * Bytes at the start of the OS file reserved for the directory.
+   */
+  static const std::uint32_t METADATA_SIZE = 1 << 20;
+
+  /**
+   * Creates a new, empty tablespace.
+   *
+   * @param path          Path of the OS file.
+   * @param extent_pages  Size of the extents segments are grown by, in pages.
+   * @throws  FileExistsException   If the file already exists.
+   */
+  static std::shared_ptr<Tablespace> create(
+      const std::string& path,
+      const std::uint32_t extent_pages = DEFAULT_EXTENT_PAGES);
+
+  /**
+   * Opens an existing tablespace.  Opening a tablespace that is already open
+   * returns the same object.
+   *
+   * @param path  Path of the OS file.
+   * @throws  FileNotFoundException If the file doesn't exist.
+   * @throws  TablespaceException   If the file is not a tablespace.
+   */
+  static std::shared_ptr<Tablespace> open(const std::string& path);
+
+  /**
+   * Closes the OS file.
+   */
+  ~Tablespace();
+
+  Tablespace(const Tablespace&) = delete;
+  Tablespace& operator=(const Tablespace&) = delete;
+
+  /**
+   * Creates a new logical file in the tablespace.
+   *
+   * @param name  Name of the file within the tablespace.
+   * @throws  FileExistsException   If the tablespace has a file of that name.
+   * @throws  TablespaceException   If the name is too long or the directory
+   *                                is full.
+   */
+  File createFile(const std::string& name);
+
+  /**
+   * Opens a logical file of the tablespace.
+   *
+   * @param name  Name of the file within the tablespace.
+   * @throws  FileNotFoundException If the tablespace has no such file.
+   */
+  File openFile(const std::string& name);
+
+  /**
+   * Deletes a logical file, returning its extents to the tablespace.
+   *
+   * @param name  Name of the file within the tablespace.
+   * @throws  FileNotFoundException If the tablespace has no such file.
+   * @throws  FileOpenException     If the file is currently open.
+   */
+  void removeFile(const std::string& name);
+
+  /**
+   * Returns true if the tablespace has a logical file of that name.
+   *
+   * @param name  Name of the file within the tablespace.
+   */
+  bool exists(const std::string& name) const;
+
+  /**
+   * Returns the names of the logical files in the tablespace.
+   */
+  std::vector<std::string> files() const;
+
+  /**
+   * Returns the name a logical file is registered under in the FileRegistry
+   * (and reported as by File::filename()).
+   *
+   * @param name  Name of the file within the tablespace.
+   */
+  std::string qualifiedName(const std::string& name) const {
+    return path() + "::" + name;
+  }
+
+  /**
+   * Returns the path of the OS file.
+   */
+  const std::string& path() const { return file_->name; }
+
+  /**
+   * Returns the size of an extent in bytes.
+   */
+  std::uint32_t extentSize() const { return header_.extent_size; }
+
+  /**
+   * Returns the number of extents in the OS file, used or free.
+   */
+  std::uint32_t numExtents() const;
+
+  /**
+   * Returns the number of extents not owned by any logical file.
+   */
+  std::uint32_t freeExtents() const;
+
+ private:
+  /**
+   * @brief Header at offset 0 of the OS file.
+   */
+  struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t extent_size;
+    std::uint32_t max_segments;
+    std::uint32_t max_extents;
+    std::uint32_t num_extents;
+    std::uint32_t reserved;
+  };
+
+  /**
+   * @brief Directory entry of one logical file.
+   */
+  struct Slot {
+    char name[MAX_NAME_LENGTH + 1];
+    std::uint32_t used;
+    std::uint32_t reserved;
+  };
+
+  /**
+   * @brief Owner of one extent: slot number plus one (zero if the extent is
+   *        free) and position of the extent within the segment.
+   */
+  struct ExtentOwner {
+    std::uint32_t slot;
+    std::uint32_t index;
+  };
+
+  /**
+   * Bytes reserved for the header before the directory.
+   */
+  static const std::uint32_t HEADER_AREA = 4096;
+
+  static const std::uint32_t VERSION = 1;
+
+  /**
+   * Takes over a reference to the registry entry of the OS file.
+   */
+  explicit Tablespace(FileRegistry::Entry* file);
+
+  /**
+   * Writes the header and an empty directory of a new tablespace.
+   */
+  void format(const std::uint32_t extent_pages);
+
+  /**
+   * Reads the header and directory of an existing tablespace.
+   */
+  void load();
+
+  /**
+   * Opener for the storage of a logical file; see FileRegistry::Opener.
+   */
+  Storage* openSegment(const std::string& name, const std::string& qualified,
+                       const bool create_new);
+
+  /**
+   * Deletes a logical file; see FileRegistry::Remover.
+   */
+  void removeSegment(const std::string& name, const std::string& qualified);
+
+  /**
+   * Reads from a segment as if it were a file of its own.
+   */
+  void read(const std::uint32_t slot, void* buffer, const std::size_t length,
+            const off_t offset) const;
+
+  /**
+   * Writes to a segment as if it were a file of its own, allocating extents
+   * as needed.
+   */
+  void write(const std::uint32_t slot, const void* buffer,
+             const std::size_t length, const off_t offset);
+
+  /**
+   * Reads consecutive bytes of a segment into <count> buffers, with one
+   * vectored read for each run of them that is contiguous in the OS file.
+   */
+  void readv(const std::uint32_t slot, const struct iovec* iov,
+             const int count, const off_t offset) const;
+
+  /**
+   * Writes <count> buffers to consecutive bytes of a segment, allocating
+   * extents as needed, with one vectored write for each run of them that is
+   * contiguous in the OS file.
+   */
+  void writev(const std::uint32_t slot, const struct iovec* iov,
+              const int count, const off_t offset);
+
+  /**
+   * Splits <count> buffers at <offset> of a segment with extents <list> at
+   * extent boundaries and calls <run> with each run of pieces that is
+   * contiguous in the OS file and the OS file offset it starts at, and
+   * <hole> with each piece past the end of the segment.  Caller holds
+   * latch_.
+   */
+  void mapRuns(const std::vector<std::uint32_t>& list,
+               const struct iovec* iov, const int count, const off_t offset,
+               const std::function<void(const std::vector<struct iovec>&,
+                                        const off_t)>& run,
+               const std::function<void(void*, const std::size_t)>& hole)
+      const;
+
+  /**
+   * Gives a segment extents up to and including position <last_index>.
+   * Caller holds latch_ exclusively.
+   */
+  void growSegment(const std::uint32_t slot, const std::uint32_t last_index);
+
+  /**
+   * Shrinks a segment to <length> bytes, releasing the extents wholly past
+   * it.
+   */
+  void truncate(const std::uint32_t slot, const off_t length);
+
+  /**
+   * Discards bytes of a segment, punching holes in its extents; the extents
+   * stay with the segment.
+   */
+  void discard(const std::uint32_t slot, const off_t offset,
+               const std::size_t length);
+
+  /**
+   * Positions of metadata records in the OS file.
+   */
+  static off_t slotOffset(const std::uint32_t slot) {
+    return HEADER_AREA + static_cast<off_t>(slot) * sizeof(Slot);
+  }
+  static off_t ownerOffset(const std::uint32_t extent) {
+    return HEADER_AREA + static_cast<off_t>(MAX_SEGMENTS) * sizeof(Slot) +
+        static_cast<off_t>(extent) * sizeof(ExtentOwner);
+  }
+  off_t extentOffset(const std::uint32_t extent) const {
+    return METADATA_SIZE + static_cast<off_t>(extent) * header_.extent_size;
+  }
+
+  /**
+   * Registry entry of the OS file; this object owns one reference.
+   */
+  FileRegistry::Entry* file_;
+
+  /**
+   * Shared for I/O on segments, exclusive for changes to the directory.
+   */
+  mutable std::shared_mutex latch_;
+
+  Header header_;
+
+  std::vector<Slot> slots_;
+
+  /**
+   * Slot of each logical file, by name.
+   */
+  std::unordered_map<std::string, std::uint32_t> names_;
+
+  /**
+   * Extents of each slot, in segment order.
+   */
+  std::vector<std::vector<std::uint32_t> > extents_;
+
+  /**
+   * Extents that belong to no segment.
+   */
+  std::vector<std::uint32_t> free_extents_;
+
+  friend class SegmentStorage;
+};
+
+}
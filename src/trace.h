@@ -0,0 +1,65 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Static tracepoints (USDT probes) for the buffer manager and file layer.
+ *
+ * When <sys/sdt.h> (systemtap-sdt-dev) is available the probes compile to a
+ * single nop plus an ELF note, so they cost nothing until perf or bpftrace
+ * attaches to them.  Otherwise, or when BADGERDB_NO_USDT is defined, they
+ * expand to nothing.  All probes live under the "badgerdb" provider:
+ *
+ * <pre>
+ * buf__hit            (file_id, page_no, frame_no)
+ * buf__miss__start    (file_id, page_no)
+ * buf__miss__done     (file_id, page_no, frame_no)
+ * buf__miss__abort    (file_id, page_no)
+ * buf__evict          (file_id, page_no, frame_no, dirty)
+ * buf__writeback      (file_id, page_no, frame_no)
+ * buf__exceeded       (num_bufs)
+ * buf__reject         (file_id, page_no)
+ * file__read__start   (filename, page_no)
+ * file__read__done    (filename, page_no)
+ * file__write__start  (filename, page_no)
+ * file__write__done   (filename, page_no)
+ * </pre>
+ *
+ * Probe arguments are evaluated whether or not a tracer is attached, so they
+ * are kept to values at hand: buffer probes, which fire under the pool latch,
+ * pass the FileRegistry id of the file (File::id()) rather than its name.
+ * Every buf__miss__start is followed on the same thread by a buf__miss__done
+ * or, if the page was not read (the pool was full, the read failed, or
+ * another thread read the page first), a buf__miss__abort for the same page.
+ *
+ * See scripts/miss_latency.bt for an example consumer.
+ */
+
+#if !defined(BADGERDB_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BADGERDB_USDT_ENABLED 1
+#endif
+#endif
+
+#ifdef BADGERDB_USDT_ENABLED
+#define BADGERDB_TRACE1(name, a1) \
+  DTRACE_PROBE1(badgerdb, name, a1)
+#define BADGERDB_TRACE2(name, a1, a2) \
+  DTRACE_PROBE2(badgerdb, name, a1, a2)
+#define BADGERDB_TRACE3(name, a1, a2, a3) \
+  DTRACE_PROBE3(badgerdb, name, a1, a2, a3)
+#define BADGERDB_TRACE4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4(badgerdb, name, a1, a2, a3, a4)
+#else
+#define BADGERDB_TRACE1(name, a1) do {} while (0)
+#define BADGERDB_TRACE2(name, a1, a2) do {} while (0)
+#define BADGERDB_TRACE3(name, a1, a2, a3) do {} while (0)
+#define BADGERDB_TRACE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
@@ -7,8 +7,15 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace badgerdb {
 
+/**
+ * @brief Identifier for a file, assigned by the FileRegistry.
+ */
+typedef std::uint32_t FileId;
+
 /**
  * @brief Identifier for a page in a file.
  */
@@ -24,6 +31,37 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Identifier for a page of a particular file, packed into one word:
+ *        the FileId in the high 32 bits and the PageId in the low 32 bits.
+ */
+typedef std::uint64_t PageKey;
+
+/**
+ * Packs a file id and a page number into a PageKey.
+ *
+ * @param file  Id of the file.
+ * @param page  Number of the page within the file.
+ * @return  Key for the page.
+ */
+inline PageKey makePageKey(const FileId file, const PageId page) {
+  return (static_cast<PageKey>(file) << 32) | page;
+}
+
+/**
+ * Returns the file id packed into a PageKey.
+ */
+inline FileId pageKeyFile(const PageKey key) {
+  return static_cast<FileId>(key >> 32);
+}
+
+/**
+ * Returns the page number packed into a PageKey.
+ */
+inline PageId pageKeyPage(const PageKey key) {
+  return static_cast<PageId>(key);
+}
+
 /**
  * @brief Identifier for a record in a page.
  */
@@ -0,0 +1,60 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * @file
+ * @brief Converts database files to the current on-disk format.
+ *
+ * Files written before the file header was versioned have a bare 16-byte
+ * header with the first page right after it.  This rewrites each named file
+ * in place with a full header page (magic, version, page size, flags) and
+ * its pages at page-size boundaries.  Files already in the current format
+ * are left alone.  The conversion is not crash-safe; keep a copy of the
+ * files until it finishes:
+ * <pre>
+ *   cp orders.db orders.db.bak && badgerdb_upgrade orders.db
+ * </pre>
+ */
+
+#include <iostream>
+#include <string>
+
+#include "file.h"
+#include "exceptions/badgerdb_exception.h"
+
+namespace badgerdb {
+namespace upgrade {
+
+int run(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " FILE...\n";
+    return 2;
+  }
+  int failures = 0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string filename = argv[i];
+    try {
+      if (File::upgrade(filename)) {
+        std::cout << filename << ": upgraded to format version "
+                  << FileHeader::CURRENT_VERSION << "\n";
+      } else {
+        std::cout << filename << ": already current\n";
+      }
+    } catch (const BadgerDbException& e) {
+      std::cerr << filename << ": " << e.message() << "\n";
+      ++failures;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+}
+}
+
+int main(int argc, char** argv) {
+  return badgerdb::upgrade::run(argc, argv);
+}
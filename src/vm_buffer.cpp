@@ -0,0 +1,343 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "vm_buffer.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+#include "file_registry.h"
+#include "exceptions/address_space_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_pinned_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Reserves <bytes> of address space that is backed by memory only once
+ * touched.
+ */
+void* reserveAddressSpace(const std::size_t bytes) {
+  void* address = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (address == MAP_FAILED) {
+    throw AddressSpaceException(bytes, errno);
+  }
+  return address;
+}
+
+}
+
+VmBufMgr::Region::Region(MemoryBudget* region_budget, const FileId file_id,
+                         const PageId max_pages)
+    : budget(region_budget),
+      file(file_id),
+      pages(NULL),
+      page_bytes(static_cast<std::size_t>(max_pages) * Page::SIZE),
+      state_chunks(region_budget, MemoryBudget::DESCRIPTORS,
+                   (static_cast<std::size_t>(max_pages) + STATE_CHUNK_PAGES -
+                    1) / STATE_CHUNK_PAGES) {
+  pages = static_cast<Page*>(reserveAddressSpace(page_bytes));
+}
+
+VmBufMgr::Region::~Region() {
+  ::munmap(pages, page_bytes);
+}
+
+std::uint64_t VmBufMgr::Region::stateBytes() const {
+  std::uint64_t bytes = state_chunks.bytes();
+  for (std::size_t i = 0; i < state_chunks.size(); ++i) {
+    if (state_chunks[i]) {
+      bytes += state_chunks[i]->bytes();
+    }
+  }
+  return bytes;
+}
+
+VmBufMgr::VmBufMgr(const std::uint32_t bufs, const PageId max_pages,
+                   MemoryBudget* shared_budget)
+    : own_budget_(shared_budget == NULL ? new MemoryBudget() : NULL),
+      budget_(shared_budget == NULL ? own_budget_.get() : shared_budget),
+      frames_reservation_(budget_, MemoryBudget::FRAMES,
+                          static_cast<std::uint64_t>(bufs) * sizeof(Page)),
+      slots_(budget_, MemoryBudget::DESCRIPTORS, bufs),
+      link_versions_(budget_, MemoryBudget::DESCRIPTORS, bufs),
+      max_pages_(max_pages),
+      clock_hand_(bufs - 1),
+      resident_(0) {
+  for (std::uint32_t i = 0; i < bufs; ++i) {
+    slots_[i] = EMPTY;
+  }
+}
+
+VmBufMgr::~VmBufMgr() {
+  try {
+    // In key order, so the pages of each file are written in page order.
+    std::vector<PageKey> dirty;
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+      const PageKey key = slots_[i];
+      if (key != EMPTY &&
+          (keyRegion(key).state(pageKeyPage(key)).flags &
+           DIRTY)) {
+        dirty.push_back(key);
+      }
+    }
+    std::sort(dirty.begin(), dirty.end());
+    for (std::size_t i = 0; i < dirty.size(); ++i) {
+      writeBack(keyRegion(dirty[i]), dirty[i]);
+    }
+  } catch (const std::exception& e) {
+    // destructors must not throw; report and carry on releasing memory
+    std::cerr << "VmBufMgr: writing back dirty pages failed: " << e.what()
+              << "\n";
+  }
+}
+
+VmBufMgr::Region& VmBufMgr::region(const File* file, const PageId page_no) {
+  if (page_no >= max_pages_) {
+    throw InvalidPageException(page_no, file->filename());
+  }
+  const FileId id = file->id();
+  const std::uint32_t index = FileRegistry::index(id);
+  if (index >= regions_.size()) {
+    regions_.resize(index + 1);
+  }
+  if (regions_[index] && regions_[index]->file != id) {
+    dropRegion(index);
+  }
+  if (!regions_[index]) {
+    regions_[index].reset(new Region(budget_, id, max_pages_));
+  }
+  return *regions_[index];
+}
+
+void VmBufMgr::dropRegion(const std::uint32_t index) {
+  Region& r = *regions_[index];
+  for (std::size_t i = 0; i < slots_.size(); ++i) {
+    const PageKey key = slots_[i];
+    if (key != EMPTY && pageKeyFile(key) == r.file &&
+        r.state(pageKeyPage(key)).pin_count > 0) {
+      throw PagePinnedException(FileRegistry::instance().name(r.file),
+                                pageKeyPage(key), i);
+    }
+  }
+  for (std::size_t i = 0; i < slots_.size(); ++i) {
+    const PageKey key = slots_[i];
+    if (key != EMPTY && pageKeyFile(key) == r.file) {
+      // The file is gone, so dirty pages are dropped, not written.
+      evict(r, key);
+    }
+  }
+  regions_[index].reset();
+}
+
+std::uint32_t VmBufMgr::allocSlot() {
+  const std::uint32_t num_slots = static_cast<std::uint32_t>(slots_.size());
+  // Two full turns: the first may only clear reference bits.
+  bool found_unpinned = false;
+  const std::uint32_t start = clock_hand_;
+  while (true) {
+    clock_hand_ = (clock_hand_ + 1) % num_slots;
+    const PageKey key = slots_[clock_hand_];
+    if (key == EMPTY) {
+      return clock_hand_;
+    }
+    Region& owner = keyRegion(key);
+    PageState& state = owner.state(pageKeyPage(key));
+    if (state.pin_count == 0) {
+      found_unpinned = true;
+      if (!(state.flags & REFERENCED)) {
+        evict(owner, key);
+        return clock_hand_;
+      }
+      state.flags &= ~REFERENCED;
+    }
+    if (clock_hand_ == start) {
+      if (!found_unpinned) {
+        throw BufferExceededException();
+      }
+      found_unpinned = false;
+    }
+  }
+}
+
+void VmBufMgr::writeBack(Region& region, const PageKey key) {
+  PageState& state = region.state(pageKeyPage(key));
+  FileRegistry::Entry* entry =
+      FileRegistry::instance().tryAcquire(pageKeyFile(key));
+  if (entry != NULL) {
+    File file(entry);  // adopts the reference
+    file.writePage(region.pages[pageKeyPage(key)], link_versions_[state.slot]);
+    stats_.diskwrites++;
+  }
+  state.flags &= ~DIRTY;
+}
+
+void VmBufMgr::evict(Region& region, const PageKey key) {
+  const PageId page_no = pageKeyPage(key);
+  PageState& state = region.state(page_no);
+  if (state.flags & DIRTY) {
+    writeBack(region, key);
+  }
+  ::madvise(&region.pages[page_no], Page::SIZE, MADV_DONTNEED);
+  slots_[state.slot] = EMPTY;
+  state.flags = 0;
+  resident_--;
+}
+
+void VmBufMgr::readPage(File* file, const PageId page_no, Page*& page) {
+  std::lock_guard<std::mutex> guard(latch_);
+  Region& r = region(file, page_no);
+  PageState& state = r.state(page_no);
+  stats_.accesses++;
+  if (state.flags & RESIDENT) {
+    state.pin_count++;
+    state.flags |= REFERENCED;
+    page = &r.pages[page_no];
+    return;
+  }
+
+  const std::uint32_t slot = allocSlot();
+  Page* const frames[1] = {&r.pages[page_no]};
+  const std::uint64_t link_version = file->linkVersion();
+  try {
+    file->readPages(page_no, 1, frames);
+  } catch (...) {
+    ::madvise(frames[0], Page::SIZE, MADV_DONTNEED);
+    throw;
+  }
+  stats_.diskreads++;
+  slots_[slot] = makePageKey(file->id(), page_no);
+  link_versions_[slot] = link_version;
+  state.slot = slot;
+  state.pin_count = 1;
+  state.flags = RESIDENT | REFERENCED;
+  resident_++;
+  page = frames[0];
+}
+
+void VmBufMgr::unPinPage(File* file, const PageId page_no, const bool dirty) {
+  std::lock_guard<std::mutex> guard(latch_);
+  Region* r = findRegion(file->id());
+  if (r == NULL || page_no >= max_pages_) {
+    return;
+  }
+  PageState* state = r->findState(page_no);
+  if (state == NULL || !(state->flags & RESIDENT)) {
+    return;
+  }
+  if (state->pin_count == 0) {
+    throw PageNotPinnedException(file->filename(), page_no, state->slot);
+  }
+  state->pin_count--;
+  if (dirty) {
+    state->flags |= DIRTY;
+  }
+}
+
+void VmBufMgr::allocPage(File* file, PageId& page_no, Page*& page) {
+  std::lock_guard<std::mutex> guard(latch_);
+  // find a slot first so a full pool does not leave an orphaned page in the
+  // file
+  const std::uint32_t slot = allocSlot();
+  Region& r = region(file, 0);
+  Page new_page = file->allocatePage();
+  const std::uint64_t link_version = file->linkVersion();
+  if (new_page.page_number() >= max_pages_) {
+    file->deletePage(new_page.page_number());
+    throw InvalidPageException(new_page.page_number(), file->filename());
+  }
+  PageState* state;
+  try {
+    state = &r.state(new_page.page_number());
+  } catch (...) {
+    file->deletePage(new_page.page_number());
+    throw;
+  }
+  page_no = new_page.page_number();
+  r.pages[page_no] = new_page;
+  stats_.accesses++;
+  stats_.diskreads++;
+
+  slots_[slot] = makePageKey(file->id(), page_no);
+  link_versions_[slot] = link_version;
+  state->slot = slot;
+  state->pin_count = 1;
+  state->flags = RESIDENT | REFERENCED;
+  resident_++;
+  page = &r.pages[page_no];
+}
+
+void VmBufMgr::flushFile(const File* file) {
+  std::lock_guard<std::mutex> guard(latch_);
+  const FileId id = file->id();
+  Region* found = findRegion(id);
+  if (found == NULL) {
+    return;
+  }
+  Region& r = *found;
+  for (std::size_t i = 0; i < slots_.size(); ++i) {
+    const PageKey key = slots_[i];
+    if (key == EMPTY || pageKeyFile(key) != id) {
+      continue;
+    }
+    const PageState& state = r.state(pageKeyPage(key));
+    if (state.pin_count > 0) {
+      throw PagePinnedException(file->filename(), pageKeyPage(key), state.slot);
+    }
+    evict(r, key);
+  }
+  // Nothing of the file is resident any more; give back its address space.
+  regions_[FileRegistry::index(id)].reset();
+}
+
+void VmBufMgr::disposePage(File* file, const PageId page_no) {
+  std::lock_guard<std::mutex> guard(latch_);
+  const FileId id = file->id();
+  Region* found = findRegion(id);
+  if (found != NULL && page_no < max_pages_) {
+    Region& r = *found;
+    PageState* state = r.findState(page_no);
+    if (state != NULL && (state->flags & RESIDENT)) {
+      if (state->pin_count > 0) {
+        throw PagePinnedException(file->filename(), page_no, state->slot);
+      }
+      // the page is going away; drop any changes rather than writing them
+      state->flags &= ~DIRTY;
+      evict(r, makePageKey(id, page_no));
+    }
+  }
+  file->deletePage(page_no);
+}
+
+std::uint32_t VmBufMgr::residentPages() const {
+  std::lock_guard<std::mutex> guard(latch_);
+  return resident_;
+}
+
+std::uint64_t VmBufMgr::memoryUsage() const {
+  std::lock_guard<std::mutex> guard(latch_);
+  std::uint64_t bytes = frames_reservation_.bytes() + slots_.bytes() +
+                        link_versions_.bytes();
+  for (std::size_t i = 0; i < regions_.size(); ++i) {
+    if (regions_[i]) {
+      bytes += regions_[i]->stateBytes();
+    }
+  }
+  return bytes;
+}
+
+}
@@ -0,0 +1,321 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "file_registry.h"
+#include "memory_budget.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Buffer pool that finds pages by address arithmetic instead of a hash
+ *        table.
+ *
+ * Each file gets a range of virtual memory large enough for max_pages pages,
+ * reserved with mmap(MAP_NORESERVE) when the file is first used; page n of the
+ * file always lives at <range start> + n * Page::SIZE.  A parallel table of
+ * PageState records whether each page is resident, pinned or dirty, so
+ * translating a page number is two array accesses.  The table is allocated,
+ * and charged to the budget, in chunks as pages in them are first used.
+ * Only resident pages are
+ * backed by physical memory: at most <bufs> at a time, chosen by a clock over
+ * the resident pages, with evicted pages returned to the OS with
+ * madvise(MADV_DONTNEED).
+ *
+ * The interface is that of BufMgr.  Pages numbered max_pages or higher can't
+ * be held; as the reservation costs only address space, max_pages can be
+ * generous.
+ *
+ * @code
+ *   VmBufMgr pool(100000);
+ *   Page* page;
+ *   pool.readPage(&file, page_no, page);
+ *   ...
+ *   pool.unPinPage(&file, page_no, false);
+ * @endcode
+ */
+class VmBufMgr {
+ public:
+  /**
+   * Pages of address space reserved per file unless another limit is given
+   * to the constructor: 64 GiB.
+   */
+  static const PageId DEFAULT_MAX_PAGES = 1u << 23;
+
+  /**
+   * Creates a pool that keeps up to <bufs> pages resident.  The frames and
+   * the clock are reserved against <shared_budget> here, the page state of a
+   * file a chunk at a time as its pages are used.
+   *
+   * @param bufs           Most pages resident at once.
+   * @param max_pages      Pages of address space reserved per file.
+   * @param shared_budget  Budget to reserve memory against, or NULL for an
+   *                       unlimited one of the pool's own.
+   * @throws  MemoryBudgetExceededException If the budget can't cover the pool.
+   */
+  VmBufMgr(const std::uint32_t bufs, const PageId max_pages = DEFAULT_MAX_PAGES,
+           MemoryBudget* shared_budget = NULL);
+
+  /**
+   * Writes back dirty pages and releases all address space.
+   */
+  ~VmBufMgr();
+
+  VmBufMgr(const VmBufMgr&) = delete;
+  VmBufMgr& operator=(const VmBufMgr&) = delete;
+
+  /**
+   * Pins a page, reading it from the file if it isn't resident.
+   *
+   * @param file     File object.
+   * @param page_no  Page number in the file.
+   * @param page     Set to the page, at its fixed address.
+   * @throws  InvalidPageException      If the page doesn't exist in the file,
+   *                                    or is numbered max_pages or higher.
+   * @throws  BufferExceededException   If every resident page is pinned.
+   * @throws  AddressSpaceException     If this is the first use of the file
+   *                                    and its range can't be reserved.
+   */
+  void readPage(File* file, const PageId page_no, Page*& page);
+
+  /**
+   * Drops a pin on a resident page.  Pages that aren't resident are ignored.
+   *
+   * @param file     File object.
+   * @param page_no  Page number in the file.
+   * @param dirty    Whether the page was modified.
+   * @throws  PageNotPinnedException    If the page isn't pinned.
+   */
+  void unPinPage(File* file, const PageId page_no, const bool dirty);
+
+  /**
+   * Allocates a new page in the file and pins it.
+   *
+   * @param file     File object.
+   * @param page_no  Set to the number of the new page.
+   * @param page     Set to the new page.
+   * @throws  BufferExceededException   If every resident page is pinned.
+   * @throws  InvalidPageException      If the new page is numbered max_pages
+   *                                    or higher; it is deleted again.
+   * @throws  AddressSpaceException     If this is the first use of the file
+   *                                    and its range can't be reserved.
+   */
+  void allocPage(File* file, PageId& page_no, Page*& page);
+
+  /**
+   * Writes back the dirty pages of a file and evicts all its pages, then
+   * releases the file's address space.
+   *
+   * @param file  File object.
+   * @throws  PagePinnedException   If a page of the file is pinned.
+   */
+  void flushFile(const File* file);
+
+  /**
+   * Evicts a page without writing it back and deletes it from the file.
+   *
+   * @param file     File object.
+   * @param page_no  Page number in the file.
+   * @throws  PagePinnedException   If the page is pinned.
+   */
+  void disposePage(File* file, const PageId page_no);
+
+  /**
+   * Returns the number of resident pages.
+   */
+  std::uint32_t residentPages() const;
+
+  /**
+   * Returns the bytes this pool has reserved against its budget.
+   */
+  std::uint64_t memoryUsage() const;
+
+  BufStats& getBufStats() { return stats_; }
+
+  void clearBufStats() { stats_.clear(); }
+
+ private:
+  /**
+   * @brief Residency of one page of a file.
+   */
+  struct PageState {
+    /**
+     * Clock slot holding the page, if resident.
+     */
+    std::uint32_t slot;
+
+    std::uint32_t pin_count : 24;
+
+    std::uint32_t flags : 8;
+  };
+
+  enum : std::uint32_t { RESIDENT = 1, DIRTY = 2, REFERENCED = 4 };
+
+  /**
+   * Pages whose states are allocated together: 32 KiB of PageState.
+   */
+  static const PageId STATE_CHUNK_PAGES = 1u << 12;
+
+  /**
+   * @brief Address space of one file: its pages and their states.
+   */
+  struct Region {
+    Region(MemoryBudget* budget, const FileId file_id,
+           const PageId max_pages);
+    ~Region();
+
+    /**
+     * Returns the state of a page, allocating its chunk if it has none.
+     */
+    PageState& state(const PageId page_no) {
+      std::unique_ptr<TrackedArray<PageState> >& chunk =
+          state_chunks[page_no / STATE_CHUNK_PAGES];
+      if (!chunk) {
+        // Value-initialized: every page starts out not resident.
+        chunk.reset(new TrackedArray<PageState>(
+            budget, MemoryBudget::DESCRIPTORS, STATE_CHUNK_PAGES));
+      }
+      return (*chunk)[page_no % STATE_CHUNK_PAGES];
+    }
+
+    /**
+     * Returns the state of a page, or NULL if no page of its chunk has been
+     * used.
+     */
+    PageState* findState(const PageId page_no) {
+      TrackedArray<PageState>* chunk =
+          state_chunks[page_no / STATE_CHUNK_PAGES].get();
+      return chunk == NULL ? NULL : &(*chunk)[page_no % STATE_CHUNK_PAGES];
+    }
+
+    /**
+     * Returns the bytes of page state charged to the budget.
+     */
+    std::uint64_t stateBytes() const;
+
+    MemoryBudget* const budget;
+
+    /**
+     * File whose pages the region holds.
+     */
+    const FileId file;
+
+    Page* pages;
+    const std::size_t page_bytes;
+
+    /**
+     * States of the pages, STATE_CHUNK_PAGES to a chunk; NULL for chunks
+     * none of whose pages has been used.
+     */
+    TrackedArray<std::unique_ptr<TrackedArray<PageState> > > state_chunks;
+  };
+
+  /**
+   * Marks an empty clock slot.
+   */
+  static const PageKey EMPTY = ~static_cast<PageKey>(0);
+
+  /**
+   * Returns the region of a file, reserving it if this is the first use of
+   * the file.  Throws InvalidPageException if <page_no> is out of range.
+   */
+  Region& region(const File* file, const PageId page_no);
+
+  /**
+   * Returns the region of the file with the given id, or NULL if it has
+   * none.
+   */
+  Region* findRegion(const FileId id) {
+    const std::uint32_t index = FileRegistry::index(id);
+    if (index >= regions_.size() || !regions_[index] ||
+        regions_[index]->file != id) {
+      return NULL;
+    }
+    return regions_[index].get();
+  }
+
+  /**
+   * Returns the region holding the page of a clock slot.
+   */
+  Region& keyRegion(const PageKey key) {
+    return *regions_[FileRegistry::index(pageKeyFile(key))];
+  }
+
+  /**
+   * Evicts the pages of a removed file whose id shared its index with
+   * another file's, and releases the region.
+   *
+   * @throws  PagePinnedException   If a page of it is still pinned.
+   */
+  void dropRegion(const std::uint32_t index);
+
+  /**
+   * Returns a free clock slot, evicting an unpinned page if needed.
+   */
+  std::uint32_t allocSlot();
+
+  /**
+   * Writes a dirty page back if some File object still has the file open,
+   * and returns its memory to the OS.
+   */
+  void evict(Region& region, const PageKey key);
+
+  /**
+   * Writes back a dirty page through the file registry.
+   */
+  void writeBack(Region& region, const PageKey key);
+
+  std::unique_ptr<MemoryBudget> own_budget_;
+
+  MemoryBudget* budget_;
+
+  /**
+   * Physical memory of the resident pages.
+   */
+  MemoryReservation frames_reservation_;
+
+  /**
+   * Page held in each clock slot, or EMPTY.
+   */
+  TrackedArray<PageKey> slots_;
+
+  /**
+   * Link version of the file (File::linkVersion()) taken before the page in
+   * each clock slot was read or allocated.
+   */
+  TrackedArray<std::uint64_t> link_versions_;
+
+  const PageId max_pages_;
+
+  /**
+   * Region of each file, by FileRegistry::index() of its id; NULL for files
+   * not in use.
+   */
+  std::vector<std::unique_ptr<Region> > regions_;
+
+  std::uint32_t clock_hand_;
+
+  std::uint32_t resident_;
+
+  BufStats stats_;
+
+  /**
+   * Serializes all operations on the pool.
+   */
+  mutable std::mutex latch_;
+};
+
+}
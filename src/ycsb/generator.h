@@ -0,0 +1,171 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace badgerdb {
+namespace ycsb {
+
+/**
+ * @brief Source of uniformly distributed random numbers for the generators.
+ */
+typedef std::mt19937_64 Random;
+
+/**
+ * Returns a double uniformly distributed in [0, 1).
+ */
+inline double nextDouble(Random& rng) {
+  return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Key chooser interface.  Keys are in [0, item_count).
+ */
+class KeyGenerator {
+ public:
+  virtual ~KeyGenerator() {}
+
+  /**
+   * Returns the next key among <item_count> items.  The item count may grow
+   * between calls as records are inserted.
+   */
+  virtual std::uint64_t next(Random& rng, const std::uint64_t item_count) = 0;
+};
+
+/**
+ * @brief Every key is equally likely.
+ */
+class UniformGenerator : public KeyGenerator {
+ public:
+  std::uint64_t next(Random& rng, const std::uint64_t item_count) {
+    return rng() % item_count;
+  }
+};
+
+/**
+ * @brief Zipfian distribution over [0, item_count), where small keys are the
+ *        most popular.
+ *
+ * Uses the algorithm from Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases" (SIGMOD 1994), as YCSB does.  The zeta constant is
+ * extended incrementally when the item count grows.
+ *
+ * @warning This class is not threadsafe; give each thread its own copy.
+ */
+class ZipfianGenerator : public KeyGenerator {
+ public:
+  /**
+   * YCSB's default skew.
+   */
+  static constexpr double DEFAULT_THETA = 0.99;
+
+  /**
+   * @param item_count  Initial number of items (zeta is precomputed for it).
+   * @param theta       Skew; 0 is uniform, values close to 1 very skewed.
+   */
+  ZipfianGenerator(const std::uint64_t item_count,
+                   const double theta = DEFAULT_THETA)
+      : theta_(theta),
+        alpha_(1.0 / (1.0 - theta)),
+        zeta2_(zeta(0, 2, theta, 0)),
+        count_for_zeta_(0),
+        zetan_(0),
+        eta_(0) {
+    extend(item_count);
+  }
+
+  std::uint64_t next(Random& rng, const std::uint64_t item_count) {
+    if (item_count > count_for_zeta_) {
+      extend(item_count);
+    }
+    const double u = nextDouble(rng);
+    const double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {
+      return item_count > 1 ? 1 : 0;
+    }
+    const std::uint64_t ret = static_cast<std::uint64_t>(
+        item_count * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return ret < item_count ? ret : item_count - 1;
+  }
+
+ private:
+  static double zeta(const std::uint64_t from, const std::uint64_t to,
+                     const double theta, const double initial) {
+    double sum = initial;
+    for (std::uint64_t i = from; i < to; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+    }
+    return sum;
+  }
+
+  void extend(const std::uint64_t item_count) {
+    zetan_ = zeta(count_for_zeta_, item_count, theta_, zetan_);
+    count_for_zeta_ = item_count;
+    eta_ = (1 - std::pow(2.0 / item_count, 1 - theta_)) /
+           (1 - zeta2_ / zetan_);
+  }
+
+  double theta_;
+  double alpha_;
+  double zeta2_;
+  std::uint64_t count_for_zeta_;
+  double zetan_;
+  double eta_;
+};
+
+/**
+ * @brief Zipfian popularity with the popular keys scattered over the key
+ *        space (YCSB's default request distribution).
+ */
+class ScrambledZipfianGenerator : public KeyGenerator {
+ public:
+  explicit ScrambledZipfianGenerator(const ZipfianGenerator& zipf)
+      : zipf_(zipf) {}
+
+  std::uint64_t next(Random& rng, const std::uint64_t item_count) {
+    return fnv64(zipf_.next(rng, item_count)) % item_count;
+  }
+
+ private:
+  static std::uint64_t fnv64(std::uint64_t value) {
+    std::uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+      hash ^= value & 0xff;
+      hash *= 1099511628211ULL;
+      value >>= 8;
+    }
+    return hash;
+  }
+
+  ZipfianGenerator zipf_;
+};
+
+/**
+ * @brief Zipfian over recency: the most recently inserted keys are the most
+ *        popular (YCSB workload D).
+ */
+class LatestGenerator : public KeyGenerator {
+ public:
+  explicit LatestGenerator(const ZipfianGenerator& zipf) : zipf_(zipf) {}
+
+  std::uint64_t next(Random& rng, const std::uint64_t item_count) {
+    return item_count - 1 - zipf_.next(rng, item_count);
+  }
+
+ private:
+  ZipfianGenerator zipf_;
+};
+
+}
+}
@@ -0,0 +1,114 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+namespace ycsb {
+
+/**
+ * @brief Log-linear latency histogram with bounded relative error.
+ *
+ * Values below 64 are counted exactly; larger values fall into one of 32
+ * linear sub-buckets per power of two, so reported percentiles are within
+ * about 3% of the true value.  Recording is a couple of shifts and an
+ * increment, cheap enough to do on every operation.
+ *
+ * @warning This class is not threadsafe; keep one per thread and merge().
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram()
+      : buckets_(NUM_BUCKETS, 0), count_(0), sum_(0), max_(0) {}
+
+  /**
+   * Records one value (nanoseconds by convention).
+   */
+  void record(const std::uint64_t value) {
+    ++buckets_[bucketOf(value)];
+    ++count_;
+    sum_ += value;
+    max_ = std::max(max_, value);
+  }
+
+  /**
+   * Adds all values recorded in <other> to this histogram.
+   */
+  void merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < buckets_.size(); ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  std::uint64_t count() const { return count_; }
+
+  std::uint64_t max() const { return max_; }
+
+  double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+
+  /**
+   * Returns the value at the given percentile (0-100).
+   */
+  std::uint64_t percentile(const double pct) const {
+    if (count_ == 0) {
+      return 0;
+    }
+    std::uint64_t rank = static_cast<std::uint64_t>(pct / 100.0 * count_);
+    if (rank >= count_) {
+      rank = count_ - 1;
+    }
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen > rank) {
+        return std::min(valueOf(i), max_);
+      }
+    }
+    return max_;
+  }
+
+ private:
+  static const int SUB_BITS = 5;
+  static const std::size_t LINEAR = 64;
+  static const std::size_t NUM_BUCKETS = LINEAR + (64 - 6) * (1 << SUB_BITS);
+
+  static std::size_t bucketOf(const std::uint64_t value) {
+    if (value < LINEAR) {
+      return value;
+    }
+    const int exp = 63 - __builtin_clzll(value);
+    const std::size_t sub = (value >> (exp - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+    return LINEAR + (exp - 6) * (1 << SUB_BITS) + sub;
+  }
+
+  /**
+   * Upper bound of the values counted in bucket <i>.
+   */
+  static std::uint64_t valueOf(const std::size_t i) {
+    if (i < LINEAR) {
+      return i;
+    }
+    const int exp = static_cast<int>((i - LINEAR) >> SUB_BITS) + 6;
+    const std::uint64_t sub = (i - LINEAR) & ((1 << SUB_BITS) - 1);
+    return (((1ULL << SUB_BITS) + sub + 1) << (exp - SUB_BITS)) - 1;
+  }
+
+  std::vector<std::uint64_t> buckets_;
+  std::uint64_t count_;
+  std::uint64_t sum_;
+  std::uint64_t max_;
+};
+
+}
+}
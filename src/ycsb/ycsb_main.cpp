@@ -0,0 +1,578 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * @file
+ * @brief YCSB-style load generator for BufMgr.
+ *
+ * Loads a table of fixed-size records into a BadgerDB file through the buffer
+ * manager, then runs one of the YCSB core workloads against it from several
+ * threads for a fixed duration and reports throughput and latency
+ * percentiles per operation type in YCSB's output format.
+ *
+ * <pre>
+ *   workload  mix                                   key distribution
+ *   a         50% read, 50% update                  zipfian
+ *   b         95% read, 5% update                   zipfian
+ *   c         100% read                             zipfian
+ *   d         95% read, 5% insert                   latest
+ *   e         95% scan, 5% insert                   zipfian
+ *   f         50% read, 50% read-modify-write       zipfian
+ * </pre>
+ *
+ * Records are laid out densely: key k lives on page 1 + k / per_page in slot
+ * 1 + k % per_page, so no separate index is needed.  Record contents are
+ * protected by a striped set of page latches, standing in for the lock
+ * manager a real engine would put above the buffer pool.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "exceptions/badgerdb_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "ycsb/generator.h"
+#include "ycsb/histogram.h"
+
+namespace badgerdb {
+namespace ycsb {
+
+namespace {
+
+enum OpType { READ, UPDATE, INSERT, SCAN, READ_MODIFY_WRITE, NUM_OP_TYPES };
+
+const char* const OP_NAMES[NUM_OP_TYPES] = {
+  "READ", "UPDATE", "INSERT", "SCAN", "READ-MODIFY-WRITE"
+};
+
+enum Distribution { UNIFORM, ZIPFIAN, LATEST };
+
+/**
+ * @brief Command line configuration.
+ */
+struct Config {
+  char workload;
+  std::uint64_t records;
+  std::size_t record_size;
+  std::uint32_t pool_frames;
+  unsigned admission_window;  // percent of frames; 0 means no admission
+  bool background_writer;
+  unsigned eviction_batch;
+  int threads;
+  double duration;
+  double warmup;
+  int max_scan;
+  double theta;
+  int distribution;  // -1 means the workload's default
+  std::uint64_t seed;
+  std::string filename;
+
+  Config()
+      : workload('a'),
+        records(100000),
+        record_size(1000),
+        pool_frames(1024),
+        admission_window(0),
+        background_writer(false),
+        eviction_batch(BufMgr::DEFAULT_EVICTION_BATCH),
+        threads(1),
+        duration(10),
+        warmup(0),
+        max_scan(100),
+        theta(ZipfianGenerator::DEFAULT_THETA),
+        distribution(-1),
+        seed(42),
+        filename("ycsb.db") {}
+};
+
+/**
+ * @brief Operation mix of a workload, as cumulative proportions.
+ */
+struct Mix {
+  double read;
+  double update;
+  double insert;
+  double scan;
+  double rmw;
+  int distribution;
+};
+
+bool workloadMix(const char workload, Mix& mix) {
+  switch (workload) {
+    case 'a': mix = {0.50, 0.50, 0.00, 0.00, 0.00, ZIPFIAN}; return true;
+    case 'b': mix = {0.95, 0.05, 0.00, 0.00, 0.00, ZIPFIAN}; return true;
+    case 'c': mix = {1.00, 0.00, 0.00, 0.00, 0.00, ZIPFIAN}; return true;
+    case 'd': mix = {0.95, 0.00, 0.05, 0.00, 0.00, LATEST}; return true;
+    case 'e': mix = {0.00, 0.00, 0.05, 0.95, 0.00, ZIPFIAN}; return true;
+    case 'f': mix = {0.50, 0.00, 0.00, 0.00, 0.50, ZIPFIAN}; return true;
+  }
+  return false;
+}
+
+/**
+ * @brief The table under test: one BadgerDB file accessed through a BufMgr.
+ */
+class Table {
+ public:
+  static const std::size_t NUM_LATCHES = 4096;
+
+  Table(BufMgr* buf_mgr, File* file, const std::size_t record_size)
+      : buf_mgr_(buf_mgr),
+        file_(file),
+        record_size_(record_size),
+        per_page_(recordsPerPage(record_size)),
+        count_(0),
+        latches_(new std::mutex[NUM_LATCHES]) {
+  }
+
+  std::uint64_t count() const {
+    return count_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Appends the record for the next key.  Inserts are serialized.
+   */
+  void insert(Random& rng) {
+    std::lock_guard<std::mutex> insert_guard(insert_latch_);
+    const std::uint64_t key = count_.load(std::memory_order_relaxed);
+    const RecordId rid = ridOf(key);
+    Page* page;
+    PageId page_no = rid.page_number;
+    if (rid.slot_number == 1) {
+      buf_mgr_->allocPage(file_, page_no, page);
+      if (page_no != rid.page_number) {
+        throw std::runtime_error("table file is not densely allocated");
+      }
+    } else {
+      buf_mgr_->readPage(file_, page_no, page);
+    }
+    {
+      std::lock_guard<std::mutex> guard(latchFor(page_no));
+      page->insertRecord(makeRecord(key, rng));
+    }
+    buf_mgr_->unPinPage(file_, page_no, true);
+    count_.store(key + 1, std::memory_order_release);
+  }
+
+  void read(const std::uint64_t key) {
+    const RecordId rid = ridOf(key);
+    Page* page;
+    buf_mgr_->readPage(file_, rid.page_number, page);
+    {
+      std::lock_guard<std::mutex> guard(latchFor(rid.page_number));
+      check(key, page->getRecord(rid));
+    }
+    buf_mgr_->unPinPage(file_, rid.page_number, false);
+  }
+
+  void update(const std::uint64_t key, Random& rng) {
+    const RecordId rid = ridOf(key);
+    const std::string record = makeRecord(key, rng);
+    Page* page;
+    buf_mgr_->readPage(file_, rid.page_number, page);
+    {
+      std::lock_guard<std::mutex> guard(latchFor(rid.page_number));
+      page->updateRecord(rid, record);
+    }
+    buf_mgr_->unPinPage(file_, rid.page_number, true);
+  }
+
+  void readModifyWrite(const std::uint64_t key, Random& rng) {
+    const RecordId rid = ridOf(key);
+    Page* page;
+    buf_mgr_->readPage(file_, rid.page_number, page);
+    {
+      std::lock_guard<std::mutex> guard(latchFor(rid.page_number));
+      std::string record = page->getRecord(rid);
+      check(key, record);
+      // Rewrite one 100-byte "field" as YCSB does.
+      const std::size_t field = (rng() % ((record.size() + 99) / 100)) * 100;
+      for (std::size_t i = field; i < record.size() && i < field + 100; ++i) {
+        record[i] = 'a' + rng() % 26;
+      }
+      std::memcpy(&record[0], &key, std::min(sizeof(key), record.size()));
+      page->updateRecord(rid, record);
+    }
+    buf_mgr_->unPinPage(file_, rid.page_number, true);
+  }
+
+  void scan(const std::uint64_t start, const std::uint64_t length) {
+    const std::uint64_t end = std::min(start + length, count());
+    std::uint64_t key = start;
+    while (key < end) {
+      const PageId page_no = ridOf(key).page_number;
+      Page* page;
+      buf_mgr_->readPage(file_, page_no, page);
+      {
+        std::lock_guard<std::mutex> guard(latchFor(page_no));
+        for (; key < end && ridOf(key).page_number == page_no; ++key) {
+          check(key, page->getRecord(ridOf(key)));
+        }
+      }
+      buf_mgr_->unPinPage(file_, page_no, false);
+    }
+  }
+
+  std::size_t perPage() const { return per_page_; }
+
+ private:
+  static std::size_t recordsPerPage(const std::size_t record_size) {
+    Page page;
+    const std::string record(record_size, 'x');
+    std::size_t n = 0;
+    while (page.hasSpaceForRecord(record)) {
+      page.insertRecord(record);
+      ++n;
+    }
+    return n;
+  }
+
+  RecordId ridOf(const std::uint64_t key) const {
+    RecordId rid;
+    rid.page_number = static_cast<PageId>(1 + key / per_page_);
+    rid.slot_number = static_cast<SlotId>(1 + key % per_page_);
+    return rid;
+  }
+
+  std::mutex& latchFor(const PageId page_no) {
+    return latches_[page_no % NUM_LATCHES];
+  }
+
+  std::string makeRecord(const std::uint64_t key, Random& rng) const {
+    std::string record(record_size_, ' ');
+    for (std::size_t i = 0; i < record.size(); ++i) {
+      record[i] = 'a' + rng() % 26;
+    }
+    std::memcpy(&record[0], &key, std::min(sizeof(key), record.size()));
+    return record;
+  }
+
+  void check(const std::uint64_t key, const std::string& record) const {
+    std::uint64_t stored = 0;
+    std::memcpy(&stored, record.data(), std::min(sizeof(key), record.size()));
+    if (record.size() != record_size_ ||
+        (record_size_ >= sizeof(key) && stored != key)) {
+      std::cerr << "record for key " << key << " is corrupt\n";
+      std::abort();
+    }
+  }
+
+  BufMgr* buf_mgr_;
+  File* file_;
+  std::size_t record_size_;
+  std::size_t per_page_;
+  std::atomic<std::uint64_t> count_;
+  std::mutex insert_latch_;
+  std::unique_ptr<std::mutex[]> latches_;
+};
+
+/**
+ * @brief Per-thread results.
+ */
+struct ThreadResult {
+  LatencyHistogram latency[NUM_OP_TYPES];
+  std::uint64_t failures;
+
+  ThreadResult() : failures(0) {}
+};
+
+void runClient(Table& table, const Config& config, const Mix& mix,
+               const ZipfianGenerator& zipf, const int thread_id,
+               const std::atomic<int>& phase, ThreadResult& result) {
+  Random rng(config.seed * 1000003 + thread_id);
+  std::unique_ptr<KeyGenerator> keys;
+  const int distribution = config.distribution >= 0 ?
+      config.distribution : mix.distribution;
+  switch (distribution) {
+    case UNIFORM: keys.reset(new UniformGenerator()); break;
+    case LATEST: keys.reset(new LatestGenerator(zipf)); break;
+    default: keys.reset(new ScrambledZipfianGenerator(zipf)); break;
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  while (phase.load(std::memory_order_relaxed) != 2) {
+    const bool measuring = phase.load(std::memory_order_relaxed) == 1;
+    const double p = nextDouble(rng);
+    OpType op;
+    if (p < mix.read) {
+      op = READ;
+    } else if (p < mix.read + mix.update) {
+      op = UPDATE;
+    } else if (p < mix.read + mix.update + mix.insert) {
+      op = INSERT;
+    } else if (p < mix.read + mix.update + mix.insert + mix.scan) {
+      op = SCAN;
+    } else {
+      op = READ_MODIFY_WRITE;
+    }
+
+    const Clock::time_point start = Clock::now();
+    try {
+      switch (op) {
+        case READ: table.read(keys->next(rng, table.count())); break;
+        case UPDATE: table.update(keys->next(rng, table.count()), rng); break;
+        case INSERT: table.insert(rng); break;
+        case SCAN:
+          table.scan(keys->next(rng, table.count()),
+                     1 + rng() % config.max_scan);
+          break;
+        default:
+          table.readModifyWrite(keys->next(rng, table.count()), rng);
+          break;
+      }
+    } catch (const BadgerDbException& e) {
+      // Typically BufferExceededException: more concurrent pins than frames.
+      if (measuring) {
+        ++result.failures;
+      }
+      continue;
+    }
+    if (measuring) {
+      result.latency[op].record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              Clock::now() - start).count());
+    }
+  }
+}
+
+void usage(const char* prog) {
+  std::cerr
+      << "usage: " << prog << " [options]\n"
+      << "  --workload=a|b|c|d|e|f   YCSB core workload (default a)\n"
+      << "  --records=N              records loaded before the run (100000)\n"
+      << "  --record_size=BYTES      bytes per record (1000)\n"
+      << "  --pool=FRAMES            buffer pool frames (1024)\n"
+      << "  --admission=PERCENT      TinyLFU admission with a window of PERCENT\n"
+      << "                           of the frames (off)\n"
+      << "  --writer=0|1             run the pool's background writer (0)\n"
+      << "  --evict_batch=N          victims collected per clock sweep (16)\n"
+      << "  --threads=N              client threads (1)\n"
+      << "  --duration=SECONDS       measured run time (10)\n"
+      << "  --warmup=SECONDS         unmeasured run time before that (0)\n"
+      << "  --distribution=uniform|zipfian|latest  override key distribution\n"
+      << "  --theta=T                zipfian skew (0.99)\n"
+      << "  --max_scan=N             maximum scan length (100)\n"
+      << "  --seed=N                 random seed (42)\n"
+      << "  --file=NAME              table file, recreated (ycsb.db)\n";
+}
+
+bool parseArgs(int argc, char** argv, Config& config) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const std::size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      return false;
+    }
+    const std::string key = arg.substr(2, eq - 2);
+    const std::string value = arg.substr(eq + 1);
+    if (key == "workload" && value.size() == 1) {
+      config.workload = value[0];
+    } else if (key == "records") {
+      config.records = std::strtoull(value.c_str(), NULL, 10);
+    } else if (key == "record_size") {
+      config.record_size = std::strtoul(value.c_str(), NULL, 10);
+    } else if (key == "pool") {
+      config.pool_frames = std::strtoul(value.c_str(), NULL, 10);
+    } else if (key == "admission") {
+      config.admission_window = std::strtoul(value.c_str(), NULL, 10);
+    } else if (key == "writer") {
+      config.background_writer = std::atoi(value.c_str()) != 0;
+    } else if (key == "evict_batch") {
+      config.eviction_batch = std::strtoul(value.c_str(), NULL, 10);
+    } else if (key == "threads") {
+      config.threads = std::atoi(value.c_str());
+    } else if (key == "duration") {
+      config.duration = std::atof(value.c_str());
+    } else if (key == "warmup") {
+      config.warmup = std::atof(value.c_str());
+    } else if (key == "theta") {
+      config.theta = std::atof(value.c_str());
+    } else if (key == "max_scan") {
+      config.max_scan = std::atoi(value.c_str());
+    } else if (key == "seed") {
+      config.seed = std::strtoull(value.c_str(), NULL, 10);
+    } else if (key == "file") {
+      config.filename = value;
+    } else if (key == "distribution") {
+      if (value == "uniform") {
+        config.distribution = UNIFORM;
+      } else if (value == "zipfian") {
+        config.distribution = ZIPFIAN;
+      } else if (value == "latest") {
+        config.distribution = LATEST;
+      } else {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return config.records > 0 && config.record_size > 0 &&
+         config.record_size < Page::DATA_SIZE / 2 &&
+         config.pool_frames > 0 && config.threads > 0 &&
+         config.max_scan > 0 && config.theta > 0 && config.theta < 1;
+}
+
+void removeIfExists(const std::string& filename) {
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException&) {
+  }
+}
+
+void report(const char* section, const char* metric, const double value) {
+  char line[128];
+  std::snprintf(line, sizeof(line), "[%s], %s, %.2f", section, metric, value);
+  std::cout << line << "\n";
+}
+
+}
+
+int run(int argc, char** argv) {
+  Config config;
+  Mix mix;
+  if (!parseArgs(argc, argv, config) || !workloadMix(config.workload, mix)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  removeIfExists(config.filename);
+  int status = 0;
+  {
+    File file = File::create(config.filename);
+    BufMgr buf_mgr(config.pool_frames);
+    buf_mgr.setEvictionBatch(config.eviction_batch);
+    if (config.admission_window > 0) {
+      buf_mgr.enableAdmission(config.admission_window);
+    }
+    if (config.background_writer) {
+      buf_mgr.startBackgroundWriter();
+    }
+    Table table(&buf_mgr, &file, config.record_size);
+
+    // Load phase.
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point load_start = Clock::now();
+    Random load_rng(config.seed);
+    for (std::uint64_t i = 0; i < config.records; ++i) {
+      table.insert(load_rng);
+    }
+    buf_mgr.flushFile(&file);
+    const double load_seconds =
+        std::chrono::duration<double>(Clock::now() - load_start).count();
+    std::cout << "# loaded " << config.records << " records of "
+              << config.record_size << " bytes (" << table.perPage()
+              << " per page) in " << load_seconds << " s\n";
+    std::cout << "# workload " << config.workload << ", " << config.threads
+              << " threads, " << config.pool_frames << " frames ("
+              << (config.pool_frames * Page::SIZE) / (1024 * 1024)
+              << " MiB), " << config.duration << " s\n";
+
+    // Run phase.
+    buf_mgr.clearBufStats();
+    const ZipfianGenerator zipf(config.records, config.theta);
+    std::atomic<int> phase(config.warmup > 0 ? 0 : 1);
+    std::vector<ThreadResult> results(config.threads);
+    std::vector<std::thread> clients;
+    for (int t = 0; t < config.threads; ++t) {
+      clients.push_back(std::thread(runClient, std::ref(table),
+                                    std::cref(config), std::cref(mix),
+                                    std::cref(zipf), t, std::cref(phase),
+                                    std::ref(results[t])));
+    }
+    if (config.warmup > 0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(config.warmup));
+      buf_mgr.clearBufStats();
+      phase.store(1);
+    }
+    const Clock::time_point run_start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(config.duration));
+    phase.store(2);
+    for (std::size_t t = 0; t < clients.size(); ++t) {
+      clients[t].join();
+    }
+    const double run_seconds =
+        std::chrono::duration<double>(Clock::now() - run_start).count();
+
+    ThreadResult total;
+    for (std::size_t t = 0; t < results.size(); ++t) {
+      for (int op = 0; op < NUM_OP_TYPES; ++op) {
+        total.latency[op].merge(results[t].latency[op]);
+      }
+      total.failures += results[t].failures;
+    }
+    std::uint64_t ops = 0;
+    for (int op = 0; op < NUM_OP_TYPES; ++op) {
+      ops += total.latency[op].count();
+    }
+
+    report("OVERALL", "RunTime(ms)", run_seconds * 1000);
+    report("OVERALL", "Throughput(ops/sec)", ops / run_seconds);
+    const BufStats stats = buf_mgr.getBufStats();
+    report("BUFFER", "Accesses", stats.accesses);
+    report("BUFFER", "DiskReads", stats.diskreads);
+    report("BUFFER", "DiskWrites", stats.diskwrites);
+    report("BUFFER", "SyncWrites", stats.syncWrites);
+    report("BUFFER", "IoWaits", stats.ioWaits);
+    report("BUFFER", "CachedVictims", stats.cachedVictims);
+    if (config.background_writer) {
+      report("BUFFER", "BackgroundWrites", stats.backgroundWrites);
+      report("BUFFER", "BackgroundWriteErrors", stats.backgroundWriteErrors);
+    }
+    if (config.admission_window > 0) {
+      report("BUFFER", "AdmissionRejections", stats.rejections);
+    }
+    report("BUFFER", "HitRatio",
+           stats.accesses ?
+               1.0 - static_cast<double>(stats.diskreads) / stats.accesses : 0);
+    for (int op = 0; op < NUM_OP_TYPES; ++op) {
+      const LatencyHistogram& h = total.latency[op];
+      if (h.count() == 0) {
+        continue;
+      }
+      report(OP_NAMES[op], "Operations", h.count());
+      report(OP_NAMES[op], "AverageLatency(us)", h.mean() / 1000);
+      report(OP_NAMES[op], "MinLatency(us)", h.percentile(0) / 1000.0);
+      report(OP_NAMES[op], "MaxLatency(us)", h.max() / 1000.0);
+      report(OP_NAMES[op], "50thPercentileLatency(us)",
+             h.percentile(50) / 1000.0);
+      report(OP_NAMES[op], "95thPercentileLatency(us)",
+             h.percentile(95) / 1000.0);
+      report(OP_NAMES[op], "99thPercentileLatency(us)",
+             h.percentile(99) / 1000.0);
+      report(OP_NAMES[op], "99.9thPercentileLatency(us)",
+             h.percentile(99.9) / 1000.0);
+    }
+    if (total.failures > 0) {
+      report("OVERALL", "FailedOperations", total.failures);
+      status = 2;
+    }
+  }
+  removeIfExists(config.filename);
+  return status;
+}
+
+}
+}
+
+int main(int argc, char** argv) {
+  return badgerdb::ycsb::run(argc, argv);
+}